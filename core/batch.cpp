@@ -54,6 +54,23 @@ namespace RayGene3D
   {
   }
 
+  void Batch::VisitView(std::function<bool(const std::shared_ptr<View>&, Access)> visitor) const
+  {
+    for (const auto& entity : entities)
+    {
+      for (const auto& va_view : entity.va_views) if (va_view && visitor(va_view, ACCESS_VERTEX_ARRAY)) return;
+      for (const auto& ia_view : entity.ia_views) if (ia_view && visitor(ia_view, ACCESS_INDEX_ARRAY)) return;
+      if (entity.arg_view && visitor(entity.arg_view, ACCESS_ARGUMENT)) return;
+    }
+
+    for (const auto& ub_view : ub_views) if (ub_view && visitor(ub_view, ACCESS_UNIFORM_BUFFER)) return;
+    for (const auto& sb_view : sb_views) if (sb_view && visitor(sb_view, ACCESS_SHIFTED_BUFFER)) return;
+    for (const auto& ri_view : ri_views) if (ri_view && visitor(ri_view, ACCESS_READ_IMAGE)) return;
+    for (const auto& wi_view : wi_views) if (wi_view && visitor(wi_view, ACCESS_WRITE_IMAGE)) return;
+    for (const auto& rb_view : rb_views) if (rb_view && visitor(rb_view, ACCESS_READ_BUFFER)) return;
+    for (const auto& wb_view : wb_views) if (wb_view && visitor(wb_view, ACCESS_WRITE_BUFFER)) return;
+  }
+
   Batch::~Batch()
   {
   }
@@ -44,6 +44,21 @@ namespace RayGene3D
     using SBOffset = std::optional<std::array<uint32_t, 4>>;
     using PushData = std::optional<std::array<uint8_t, 128>>;
 
+  public:
+    enum Access
+    {
+      ACCESS_UNKNOWN = 0,
+      ACCESS_VERTEX_ARRAY = 1,
+      ACCESS_INDEX_ARRAY = 2,
+      ACCESS_ARGUMENT = 3,
+      ACCESS_UNIFORM_BUFFER = 4,
+      ACCESS_SHIFTED_BUFFER = 5,
+      ACCESS_READ_IMAGE = 6,
+      ACCESS_WRITE_IMAGE = 7,
+      ACCESS_READ_BUFFER = 8,
+      ACCESS_WRITE_BUFFER = 9,
+    };
+
   public:
     static const uint32_t va_limit =16u;
     static const uint32_t ia_limit = 1u;
@@ -76,6 +91,7 @@ namespace RayGene3D
       View::Range idx_or_grid_z;
       SBOffset sb_offset{ std::nullopt };
       PushData push_data{ std::nullopt };
+      uint32_t hit_group{ 0 }; //hit group variant for tracing
     };
 
   public:
@@ -154,6 +170,9 @@ namespace RayGene3D
   //  void VisitMesh(std::function<void(const std::shared_ptr<Mesh>&)> visitor) { for (const auto& mesh : meshes) visitor(mesh); }
   //  void DestroyMesh(const std::shared_ptr<Mesh>& mesh) { meshes.remove(mesh); }
 
+  public:
+    void VisitView(std::function<bool(const std::shared_ptr<View>&, Access)> visitor) const;
+
   public:
     void Initialize() override = 0;
     void Use() override = 0;
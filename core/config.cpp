@@ -28,9 +28,15 @@ THE SOFTWARE.
 
 
 #include "config.h"
+#include "device.h"
 
 namespace RayGene3D
 {
+  void Config::DestroyBatch(const std::shared_ptr<Batch>& batch)
+  {
+    if(batch) { pass.GetDevice().Retire(batch); batches.remove(batch); }
+  }
+
   Config::Config(const std::string& name,
     Pass& pass,
     const std::string& source,
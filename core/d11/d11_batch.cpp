@@ -203,7 +203,7 @@ namespace RayGene3D
           if (va_view)
           {
             va_items[i] = (reinterpret_cast<D11Resource*>(&va_view->GetResource()))->GetBuffer();
-            va_offsets[i] = va_view->GetMipmapsOrCount().offset;
+            va_offsets[i] = UINT(va_view->GetMipmapsOrCount().offset);
             va_strides[i] = config->GetStrides().at(i);
           }
         }
@@ -220,7 +220,7 @@ namespace RayGene3D
           if (ia_view)
           {
             ia_items[i] = (reinterpret_cast<D11Resource*>(&ia_view->GetResource()))->GetBuffer();
-            ia_offsets[i] = ia_view->GetMipmapsOrCount().offset;
+            ia_offsets[i] = UINT(ia_view->GetMipmapsOrCount().offset);
             ia_formats[i] = config->GetIAState().indexer
               == Config::INDEXER_32_BIT ? DXGI_FORMAT_R32_UINT
               : Config::INDEXER_16_BIT ? DXGI_FORMAT_R16_UINT
@@ -168,7 +168,9 @@ namespace RayGene3D
     //  this->GetContext()->CopyResource(dst_resource, src_resource);
     //}
 
-    for (auto& pass : passes)
+    Schedule();
+
+    for (auto& pass : schedule)
     {
       pass->Use();
     }
@@ -187,6 +189,9 @@ namespace RayGene3D
 
   void D11Device::Discard()
   {
+    schedule.clear();
+    topology = 0;
+
     //for (auto& pass : passes)
     //{
     //  if (pass) { pass->Discard(); }
@@ -51,6 +51,7 @@ namespace RayGene3D
     {
       D3D11_USAGE usage = D3D11_USAGE_DEFAULT;
       usage = hint & HINT_DYNAMIC_BUFFER ? D3D11_USAGE_DYNAMIC : usage;
+      usage = hint & HINT_READBACK_BUFFER ? D3D11_USAGE_STAGING : usage;
       return usage;
     };
 
@@ -58,12 +59,14 @@ namespace RayGene3D
     {
       uint32_t access = 0;
       access = hint & HINT_DYNAMIC_BUFFER ? uint32_t(D3D11_CPU_ACCESS_WRITE) : access;
+      access = hint & HINT_READBACK_BUFFER ? uint32_t(D3D11_CPU_ACCESS_READ) : access;
       return access;
     };
 
     const auto get_misc = [this]()
     {
       uint32_t misc = 0;
+      if (hint & HINT_READBACK_BUFFER) return misc; // staging buffers are only copied to
       misc = hint & HINT_CUBEMAP_IMAGE ? misc | D3D11_RESOURCE_MISC_TEXTURECUBE : misc;
       {
         misc = (type == TYPE_BUFFER && (usage & USAGE_SHADER_RESOURCE))  ? misc | D3D11_RESOURCE_MISC_BUFFER_STRUCTURED : misc;
@@ -76,6 +79,7 @@ namespace RayGene3D
     const auto get_bind = [this]()
     {
       uint32_t bind = 0;
+      if (hint & HINT_READBACK_BUFFER) return bind;
       {
         bind = usage & USAGE_SHADER_RESOURCE ? bind | D3D11_BIND_SHADER_RESOURCE : bind;
         bind = usage & USAGE_RENDER_TARGET ? bind | D3D11_BIND_RENDER_TARGET : bind;
@@ -167,7 +171,7 @@ namespace RayGene3D
       }
     };
 
-    const auto populate_subresources_fn = [this](const std::vector<std::pair<const void*, uint32_t>>& interops)
+    const auto populate_subresources_fn = [this](const std::vector<std::pair<const void*, uint64_t>>& interops)
     {
       BLAST_ASSERT(layers_or_stride * mipmaps_or_count == uint32_t(interops.size()));
 
@@ -183,8 +187,8 @@ namespace RayGene3D
           const auto mip_extent_y = std::max(1u, size_y >> j);
 
           result[i * mipmaps_or_count + j].pSysMem = data;
-          result[i * mipmaps_or_count + j].SysMemPitch = size / mip_extent_y;
-          result[i * mipmaps_or_count + j].SysMemSlicePitch = size / (mip_extent_x * mip_extent_y);
+          result[i * mipmaps_or_count + j].SysMemPitch = UINT(size / mip_extent_y);
+          result[i * mipmaps_or_count + j].SysMemSlicePitch = UINT(size / (mip_extent_x * mip_extent_y));
         }
       }
       return result;
@@ -194,8 +198,12 @@ namespace RayGene3D
     {
     case TYPE_BUFFER:
     {
+      // Buffer widths are 32-bit in D3D11, larger resources need the Vulkan backend
+      const auto byte_width = uint64_t(mipmaps_or_count) * layers_or_stride;
+      BLAST_ASSERT(byte_width <= UINT_MAX);
+
       D3D11_BUFFER_DESC buffer_desc = {};
-      buffer_desc.ByteWidth = mipmaps_or_count * layers_or_stride;
+      buffer_desc.ByteWidth = UINT(byte_width);
       buffer_desc.Usage = get_usage();
       buffer_desc.BindFlags = get_bind();
       buffer_desc.CPUAccessFlags = get_access();
@@ -518,13 +526,14 @@ namespace RayGene3D
   {
     D11Device* device = reinterpret_cast<D11Device*>(&this->GetDevice());
 
-    if (type != Resource::TYPE_BUFFER || ~hint & HINT_DYNAMIC_BUFFER)
+    if (type != Resource::TYPE_BUFFER || (hint & (HINT_DYNAMIC_BUFFER | HINT_READBACK_BUFFER)) == 0)
     {
       return nullptr;
     }
 
+    const auto map = hint & HINT_READBACK_BUFFER ? D3D11_MAP_READ : D3D11_MAP_WRITE_DISCARD;
     D3D11_MAPPED_SUBRESOURCE mapped_subres{ 0 };
-    BLAST_ASSERT(S_OK == device->GetContext()->Map(this->resource, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_subres));
+    BLAST_ASSERT(S_OK == device->GetContext()->Map(this->resource, 0, map, 0, &mapped_subres));
 
     return mapped_subres.pData;
   }
@@ -533,7 +542,7 @@ namespace RayGene3D
   {
     D11Device* device = reinterpret_cast<D11Device*>(&this->GetDevice());
 
-    if (type != Resource::TYPE_BUFFER || ~hint & HINT_DYNAMIC_BUFFER)
+    if (type != Resource::TYPE_BUFFER || (hint & (HINT_DYNAMIC_BUFFER | HINT_READBACK_BUFFER)) == 0)
     {
       return;
     }
@@ -545,7 +554,7 @@ namespace RayGene3D
     Device& device,
     const Resource::BufferDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     D11Resource::Initialize();
@@ -555,7 +564,7 @@ namespace RayGene3D
     Device& device,
     const Resource::Tex1DDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     D11Resource::Initialize();
@@ -565,7 +574,7 @@ namespace RayGene3D
     Device& device,
     const Resource::Tex2DDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     D11Resource::Initialize();
@@ -575,7 +584,7 @@ namespace RayGene3D
     Device& device,
     const Resource::Tex3DDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     D11Resource::Initialize();
@@ -29,8 +29,292 @@ THE SOFTWARE.
 
 #include "device.h"
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace RayGene3D
 {
+  bool Device::Schedule()
+  {
+    // Only the pass set, enable states and batches change the graph, views are fixed at creation
+    size_t topology = passes.size();
+    const auto combine_fn = [&topology](size_t value)
+    {
+      topology ^= value + 0x9e3779b9 + (topology << 6) + (topology >> 2);
+    };
+    for (const auto& pass : passes)
+    {
+      combine_fn(std::hash<const Pass*>()(pass.get()));
+      combine_fn(size_t(pass->GetEnabled()));
+      pass->VisitConfig([&combine_fn](const std::shared_ptr<Config>& config)
+      {
+        combine_fn(std::hash<const Config*>()(config.get()));
+        config->VisitBatch([&combine_fn](const std::shared_ptr<Batch>& batch)
+        {
+          combine_fn(std::hash<const Batch*>()(batch.get()));
+          return false;
+        });
+        return false;
+      });
+    }
+
+    if (topology == this->topology) return false;
+    this->topology = topology;
+
+    std::vector<std::shared_ptr<Pass>> nodes;
+    for (const auto& pass : passes)
+    {
+      if (pass->GetEnabled()) nodes.push_back(pass);
+    }
+    const auto count = uint32_t(nodes.size());
+
+    std::vector<std::vector<std::pair<const Resource*, bool>>> uses(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      nodes[i]->VisitView([&uses, i](const std::shared_ptr<View>& view, bool write)
+      {
+        uses[i].emplace_back(&view->GetResource(), write);
+        return false;
+      });
+    }
+
+    // Passes are alive when they write the screen, a host visible or read back resource or anything an alive pass reads
+    const auto root_fn = [this](const Resource* resource)
+    {
+      return resource == screen.get() || (resource->GetHint() & (Resource::HINT_DYNAMIC_BUFFER | Resource::HINT_READBACK_BUFFER)) != 0;
+    };
+
+    auto rooted = false;
+    for (const auto& pass_uses : uses)
+    {
+      for (const auto& use : pass_uses) rooted |= use.second && root_fn(use.first);
+    }
+
+    std::vector<bool> alive(count, !rooted);
+    std::set<const Resource*> consumed;
+    for (auto changed = rooted; changed; )
+    {
+      changed = false;
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        if (alive[i]) continue;
+
+        for (const auto& use : uses[i])
+        {
+          if (use.second && (root_fn(use.first) || consumed.count(use.first) > 0)) { alive[i] = true; break; }
+        }
+        if (!alive[i]) continue;
+
+        for (const auto& use : uses[i])
+        {
+          if (!use.second) consumed.insert(use.first);
+        }
+        changed = true;
+      }
+    }
+
+    // Insertion order stays the reference for every hazard on a shared resource
+    struct State
+    {
+      int32_t writer{ -1 };
+      std::vector<uint32_t> readers;
+    };
+    std::map<const Resource*, State> states;
+    std::vector<std::set<uint32_t>> predecessors(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      if (!alive[i]) continue;
+
+      for (const auto& use : uses[i])
+      {
+        auto& state = states[use.first];
+        if (state.writer != -1 && uint32_t(state.writer) != i) predecessors[i].insert(uint32_t(state.writer));
+        if (!use.second)
+        {
+          state.readers.push_back(i);
+          continue;
+        }
+        for (const auto reader : state.readers)
+        {
+          if (reader != i) predecessors[i].insert(reader);
+        }
+        state.writer = int32_t(i);
+        state.readers.clear();
+      }
+    }
+
+    // Ready passes independent of everything since the last barrier are pulled forward to share it
+    schedule.clear();
+    std::vector<bool> done(count, false);
+    std::vector<uint32_t> group;
+    for (;;)
+    {
+      int32_t pick = -1;
+      int32_t fallback = -1;
+      for (uint32_t i = 0; i < count && pick == -1; ++i)
+      {
+        if (!alive[i] || done[i]) continue;
+
+        const auto& preds = predecessors[i];
+        if (std::any_of(preds.begin(), preds.end(), [&done](uint32_t pred) { return !done[pred]; })) continue;
+        if (fallback == -1) fallback = int32_t(i);
+
+        if (std::none_of(group.begin(), group.end(), [&preds](uint32_t item) { return preds.count(item) > 0; })) pick = int32_t(i);
+      }
+
+      if (fallback == -1) break;
+      if (pick == -1)
+      {
+        group.clear();
+        pick = fallback;
+      }
+
+      done[pick] = true;
+      group.push_back(uint32_t(pick));
+      schedule.push_back(nodes[pick]);
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+    {
+      if (!alive[i]) BLAST_LOG("Culling pass [%s]", nodes[i]->GetName().c_str());
+    }
+    BLAST_LOG("Scheduled %d of %d passes", uint32_t(schedule.size()), uint32_t(passes.size()));
+
+    return true;
+  }
+
+  std::shared_ptr<void> Device::MapFile(const std::string& file,
+    const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges,
+    std::vector<std::pair<const void*, uint64_t>>& interops)
+  {
+#ifdef _WIN32
+    const auto handle = CreateFileA(file.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    BLAST_ASSERT(handle != INVALID_HANDLE_VALUE);
+    auto file_size = LARGE_INTEGER{};
+    BLAST_ASSERT(GetFileSizeEx(handle, &file_size));
+    const auto size = uint64_t(file_size.QuadPart);
+#else
+    const auto handle = open(file.c_str(), O_RDONLY);
+    BLAST_ASSERT(handle != -1);
+    struct stat file_stat {};
+    BLAST_ASSERT(fstat(handle, &file_stat) == 0);
+    const auto size = uint64_t(file_stat.st_size);
+#endif
+
+    // No ranges stand for the whole file as a single interop
+    const auto whole = std::pair<uint64_t, uint64_t>{ 0, size };
+    const auto items = ranges.second > 0 ? ranges : std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>{ &whole, 1 };
+
+    auto first = size;
+    auto last = uint64_t{ 0 };
+    for (uint32_t i = 0; i < items.second; ++i)
+    {
+      const auto [offset, length] = items.first[i];
+      BLAST_ASSERT(length > 0 && offset + length <= size);
+      first = std::min(first, offset);
+      last = std::max(last, offset + length);
+    }
+
+    // Views start on the allocation granularity, only the span the ranges touch is mapped
+#ifdef _WIN32
+    auto info = SYSTEM_INFO{};
+    GetSystemInfo(&info);
+    const auto granularity = uint64_t(info.dwAllocationGranularity);
+#else
+    const auto granularity = uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+    const auto base = first / granularity * granularity;
+    const auto span = last - base;
+
+#ifdef _WIN32
+    const auto section = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    BLAST_ASSERT(section != nullptr);
+    const auto address = MapViewOfFile(section, FILE_MAP_READ, DWORD(base >> 32), DWORD(base & 0xffffffff), SIZE_T(span));
+    BLAST_ASSERT(address != nullptr);
+    CloseHandle(section);
+    CloseHandle(handle);
+    const auto mapping = std::shared_ptr<void>(address, [](void* address) { UnmapViewOfFile(address); });
+#else
+    const auto address = mmap(nullptr, size_t(span), PROT_READ, MAP_SHARED, handle, off_t(base));
+    BLAST_ASSERT(address != MAP_FAILED);
+    close(handle);
+    madvise(address, size_t(span), MADV_SEQUENTIAL);
+    const auto mapping = std::shared_ptr<void>(address, [span](void* address) { munmap(address, size_t(span)); });
+#endif
+
+    BLAST_LOG("Mapping %llu bytes of %s", static_cast<unsigned long long>(span), file.c_str());
+
+    interops.resize(items.second);
+    for (uint32_t i = 0; i < items.second; ++i)
+    {
+      const auto [offset, length] = items.first[i];
+      interops[i] = { reinterpret_cast<const uint8_t*>(address) + (offset - base), length };
+    }
+
+    return mapping;
+  }
+
+  Resource::Hint Device::MapHint(Resource::Hint hint)
+  {
+    // Mapped pages are read-only, so they are never imported as resource memory nor kept host writable
+    BLAST_ASSERT((hint & (Resource::HINT_DYNAMIC_BUFFER | Resource::HINT_READBACK_BUFFER)) == 0);
+    return Resource::Hint((hint & ~Resource::HINT_EXTERNAL_BUFFER) | Resource::HINT_MAPPED_RESOURCE);
+  }
+
+  const std::shared_ptr<Resource>& Device::CreateResource(const std::string& name,
+    const Resource::BufferDesc& desc, const std::string& file,
+    const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges, Resource::Hint hint)
+  {
+    auto interops = std::vector<std::pair<const void*, uint64_t>>();
+    const auto mapping = MapFile(file, ranges, interops);
+    const auto& resource = CreateResource(name, desc, MapHint(hint), { interops.data(), uint32_t(interops.size()) });
+    resource->SetMapping(mapping);
+    return resource;
+  }
+
+  const std::shared_ptr<Resource>& Device::CreateResource(const std::string& name,
+    const Resource::Tex1DDesc& desc, const std::string& file,
+    const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges, Resource::Hint hint)
+  {
+    auto interops = std::vector<std::pair<const void*, uint64_t>>();
+    const auto mapping = MapFile(file, ranges, interops);
+    const auto& resource = CreateResource(name, desc, MapHint(hint), { interops.data(), uint32_t(interops.size()) });
+    resource->SetMapping(mapping);
+    return resource;
+  }
+
+  const std::shared_ptr<Resource>& Device::CreateResource(const std::string& name,
+    const Resource::Tex2DDesc& desc, const std::string& file,
+    const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges, Resource::Hint hint)
+  {
+    auto interops = std::vector<std::pair<const void*, uint64_t>>();
+    const auto mapping = MapFile(file, ranges, interops);
+    const auto& resource = CreateResource(name, desc, MapHint(hint), { interops.data(), uint32_t(interops.size()) });
+    resource->SetMapping(mapping);
+    return resource;
+  }
+
+  const std::shared_ptr<Resource>& Device::CreateResource(const std::string& name,
+    const Resource::Tex3DDesc& desc, const std::string& file,
+    const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges, Resource::Hint hint)
+  {
+    auto interops = std::vector<std::pair<const void*, uint64_t>>();
+    const auto mapping = MapFile(file, ranges, interops);
+    const auto& resource = CreateResource(name, desc, MapHint(hint), { interops.data(), uint32_t(interops.size()) });
+    resource->SetMapping(mapping);
+    return resource;
+  }
+
   Device::Device(const std::string& name) 
     : Usable(name)
   {
@@ -47,6 +47,7 @@ namespace RayGene3D
 
   protected:
     std::string path;
+    std::string cache;
     uint32_t extent_x{ 0 };
     uint32_t extent_y{ 0 };
     std::shared_ptr<Resource> screen;
@@ -57,6 +58,16 @@ namespace RayGene3D
 
     std::list<std::shared_ptr<Pass>> passes;
 
+  protected:
+    std::vector<std::shared_ptr<Pass>> schedule;
+    size_t topology{ 0 };
+
+  protected:
+    static std::shared_ptr<void> MapFile(const std::string& file,
+      const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges,
+      std::vector<std::pair<const void*, uint64_t>>& interops);
+    static Resource::Hint MapHint(Resource::Hint hint);
+
   public:
     //const void* GetHandle() const { return handle; }
     const std::string& GetName() const { return name; }
@@ -74,6 +85,8 @@ namespace RayGene3D
   public:
     void SetPath(const std::string& path) { this->path = path; }
     const std::string& GetPath() const { return path; }
+    void SetCache(const std::string& cache) { this->cache = cache; }
+    const std::string& GetCache() const { return cache; }
     void SetExtentX(uint32_t extent_x) { this->extent_x = extent_x; }
     uint32_t GetExtentX() const { return extent_x; }
     void SetExtentY(uint32_t extent_y) { this->extent_y = extent_y; }
@@ -85,19 +98,39 @@ namespace RayGene3D
     virtual const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::BufferDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) = 0;
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) = 0;
     virtual const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::Tex1DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) = 0;
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) = 0;
     virtual const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::Tex2DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) = 0;
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) = 0;
     virtual const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::Tex3DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) = 0;
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) = 0;
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::BufferDesc& desc,
+      const std::string& file,
+      const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges,
+      Resource::Hint hint = Resource::HINT_UNKNOWN);
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::Tex1DDesc& desc,
+      const std::string& file,
+      const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges,
+      Resource::Hint hint = Resource::HINT_UNKNOWN);
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::Tex2DDesc& desc,
+      const std::string& file,
+      const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges,
+      Resource::Hint hint = Resource::HINT_UNKNOWN);
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::Tex3DDesc& desc,
+      const std::string& file,
+      const std::pair<const std::pair<uint64_t, uint64_t>*, uint32_t>& ranges,
+      Resource::Hint hint = Resource::HINT_UNKNOWN);
     void VisitResource(std::function<bool(const std::shared_ptr<Resource>&)> visitor) const
     {
       for (const auto& resource : resources) if (visitor(resource)) return;
@@ -112,7 +145,7 @@ namespace RayGene3D
     }
     void DestroyResource(const std::shared_ptr<Resource>& resource)
     { 
-      if(resource) resources.remove(resource);
+      if(resource) { Retire(resource); resources.remove(resource); }
     }
 
     virtual const std::shared_ptr<Pass>& CreatePass(const std::string& name,
@@ -136,9 +169,22 @@ namespace RayGene3D
     }
     void DestroyPass(const std::shared_ptr<Pass>& pass) 
     { 
-      if(pass) passes.remove(pass);
+      if(pass) { Retire(pass); passes.remove(pass); }
     }
 
+  public:
+    // Keeps a destroyed object alive while submitted work may still use it, released at once by default
+    virtual void Retire(std::shared_ptr<void> object) {}
+
+  public:
+    void VisitSchedule(std::function<bool(const std::shared_ptr<Pass>&)> visitor) const
+    {
+      for (const auto& pass : schedule) if (visitor(pass)) return;
+    }
+
+  protected:
+    bool Schedule();
+
   public:
     void Initialize() override = 0;
     void Use() override = 0;
@@ -28,9 +28,49 @@ THE SOFTWARE.
 
 
 #include "pass.h"
+#include "device.h"
 
 namespace RayGene3D
 {
+  void Pass::DestroyConfig(const std::shared_ptr<Config>& config)
+  {
+    if(config) { device.Retire(config); configs.remove(config); }
+  }
+
+  void Pass::VisitView(std::function<bool(const std::shared_ptr<View>&, bool)> visitor) const
+  {
+    // Attachments that are loaded and storage views are read before they are written
+    for (const auto& rt_attachment : rt_attachments)
+    {
+      if (!rt_attachment.view) continue;
+      if (!rt_attachment.value && visitor(rt_attachment.view, false)) return;
+      if (visitor(rt_attachment.view, true)) return;
+    }
+
+    for (const auto& ds_attachment : ds_attachments)
+    {
+      if (!ds_attachment.view) continue;
+      if (!ds_attachment.value.first && visitor(ds_attachment.view, false)) return;
+      if (visitor(ds_attachment.view, true)) return;
+    }
+
+    auto stop = false;
+    for (const auto& config : configs)
+    {
+      config->VisitBatch([&visitor, &stop](const std::shared_ptr<Batch>& batch)
+      {
+        batch->VisitView([&visitor, &stop](const std::shared_ptr<View>& view, Batch::Access access)
+        {
+          const auto write = access == Batch::ACCESS_WRITE_IMAGE || access == Batch::ACCESS_WRITE_BUFFER;
+          stop = visitor(view, false) || (write && visitor(view, true));
+          return stop;
+        });
+        return stop;
+      });
+      if (stop) return;
+    }
+  }
+
   Pass::Pass(const std::string& name,
     Device& device,
     Pass::Type type,
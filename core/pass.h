@@ -75,6 +75,7 @@ namespace RayGene3D
 
   protected:
     bool enabled{ false };
+    bool async{ false };
 
   protected:
     Device& device;
@@ -89,6 +90,9 @@ namespace RayGene3D
     void SetEnabled(bool enabled) { this->enabled = enabled; }
     bool GetEnabled() const { return enabled; }
 
+    void SetAsync(bool async) { this->async = async; }
+    bool GetAsync() const { return async; }
+
   public:
     Device& GetDevice() { return device; }
 
@@ -101,11 +105,12 @@ namespace RayGene3D
       const Config::RCState& rc_state,
       const Config::DSState& ds_state,
       const Config::OMState& om_state) = 0;
-    //void VisitConfig(std::function<void(const std::shared_ptr<Config>&)> visitor) { for (const auto& effect : effects) visitor(effect); }
-    void DestroyConfig(const std::shared_ptr<Config>& config) 
-    { 
-      if(config) configs.remove(config);
+    void VisitConfig(std::function<bool(const std::shared_ptr<Config>&)> visitor) const
+    {
+      for (const auto& config : configs) if (visitor(config)) return;
     }
+    void DestroyConfig(const std::shared_ptr<Config>& config);
+    void VisitView(std::function<bool(const std::shared_ptr<View>&, bool)> visitor) const;
 
   public:
     void Initialize() override = 0;
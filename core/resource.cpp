@@ -28,14 +28,20 @@ THE SOFTWARE.
 
 
 #include "resource.h"
+#include "device.h"
 
 namespace RayGene3D
 {
+  void Resource::DestroyView(const std::shared_ptr<View>& view)
+  {
+    if(view) { device.Retire(view); views.remove(view); }
+  }
+
   Resource::Resource(const std::string& name,
     Device& device,
     const Resource::BufferDesc& desc,
     Resource::Hint hint, 
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Usable(name)
     , device(device)
     , type(TYPE_BUFFER)
@@ -48,7 +54,7 @@ namespace RayGene3D
   }
 
   Resource::Resource(const std::string& name, Device& device, const Resource::Tex1DDesc& desc,
-    Resource::Hint hint, const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    Resource::Hint hint, const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Usable(name)
     , device(device)
     , type(TYPE_TEX1D)
@@ -63,7 +69,7 @@ namespace RayGene3D
   }
 
   Resource::Resource(const std::string& name, Device& device, const Resource::Tex2DDesc& desc,
-    Resource::Hint hint, const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    Resource::Hint hint, const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Usable(name)
     , device(device)
     , type(TYPE_TEX2D)
@@ -79,7 +85,7 @@ namespace RayGene3D
   }
 
   Resource::Resource(const std::string& name, Device& device, const Resource::Tex3DDesc& desc,
-    Resource::Hint hint, const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    Resource::Hint hint, const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Usable(name)
     , device(device)
     , type(TYPE_TEX3D)
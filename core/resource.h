@@ -54,8 +54,14 @@ namespace RayGene3D
       HINT_UNKNOWN = 0,
       HINT_CUBEMAP_IMAGE = 0x1,
       HINT_LAYERED_IMAGE = 0x2,
+      HINT_TRANSIENT_IMAGE = 0x4,
+      HINT_STREAMING_IMAGE = 0x8,
       HINT_DYNAMIC_BUFFER = 0x10,
       HINT_ADDRESS_BUFFER = 0x20,
+      HINT_READBACK_BUFFER = 0x40,
+      HINT_SPARSE_RESOURCE = 0x80,
+      HINT_EXTERNAL_BUFFER = 0x100,
+      HINT_MAPPED_RESOURCE = 0x200, // interops are read-only mapped pages, only ever copied through staging
       HINT_FORCE_UINT = 0xffffffff
     };
 
@@ -76,11 +82,15 @@ namespace RayGene3D
     Type type{ TYPE_UNKNOWN };
     Hint hint{ HINT_UNKNOWN };
 
+  protected:
+    uint32_t detail{ uint32_t(-1) }; // finest mipmap wanted, streaming images only
+
   protected:
     std::list<std::shared_ptr<View>> views;
 
   protected:
-    std::vector<std::pair<const void*, uint32_t>> interops;
+    std::vector<std::pair<const void*, uint64_t>> interops;
+    std::shared_ptr<void> mapping; // file view the interops point into
 
   public:
     struct BufferDesc
@@ -140,6 +150,10 @@ namespace RayGene3D
     Type GetType() const { return type; }
     Hint GetHint() const { return hint; }
 
+  public:
+    void SetDetail(uint32_t detail) { this->detail = detail; }
+    uint32_t GetDetail() const { return detail; }
+
   public:
     virtual void Commit(uint32_t index) = 0;
     //virtual void Commit(uint32_t index, uint32_t offset_x, uint32_t offset_y, uint32_t offset_z, uint32_t count_x, uint32_t count_y, uint32_t count_z) = 0;
@@ -158,24 +172,22 @@ namespace RayGene3D
   public:
     virtual const std::shared_ptr<View>& CreateView(const std::string& name,
       Usage usage, 
-      const View::Range& mipmaps_or_count = View::Range{ 0, uint32_t(-1) },
-      const View::Range& layers_or_stride = View::Range{ 0, uint32_t(-1) },
+      const View::Range& mipmaps_or_count = View::Range{ 0, uint64_t(-1) },
+      const View::Range& layers_or_stride = View::Range{ 0, uint64_t(-1) },
       View::Bind bind = View::BIND_UNKNOWN
     ) = 0;
     //void VisitView(std::function<bool(const std::shared_ptr<View>&)> visitor)
     //{ 
     //  for (const auto& view : views) if (visitor(view)) return;
     //}
-    void DestroyView(const std::shared_ptr<View>& view)
-    { 
-      if(view) views.remove(view);
-    };
+    void DestroyView(const std::shared_ptr<View>& view);
 
   public:
     void SetInteropCount(uint32_t count) { interops.resize(count); }
     uint32_t GetInteropCount() const { return uint32_t(interops.size()); }
-    void SetInteropItem(uint32_t index, std::pair<const void*, uint32_t> item) { interops.at(index) = item; }
-    std::pair<const void*, uint32_t> GetInteropItem(uint32_t index) { return interops.at(index); }
+    void SetInteropItem(uint32_t index, std::pair<const void*, uint64_t> item) { interops.at(index) = item; }
+    std::pair<const void*, uint64_t> GetInteropItem(uint32_t index) { return interops.at(index); }
+    void SetMapping(const std::shared_ptr<void>& mapping) { this->mapping = mapping; }
 
   public:
     void Initialize() override = 0;
@@ -186,19 +198,19 @@ namespace RayGene3D
     Resource(const std::string& name,
       Device& device, const Resource::BufferDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     Resource(const std::string& name,
       Device& device, const Resource::Tex1DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     Resource(const std::string& name,
       Device& device, const Resource::Tex2DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     Resource(const std::string& name,
       Device& device, const Resource::Tex3DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     virtual ~Resource();
   };
 
@@ -44,14 +44,15 @@ namespace RayGene3D
       BIND_STENCIL_ONLY = 0x2L,
       BIND_CUBEMAP_LAYER = 0x4L,
       BIND_CUBEMAP_ARRAY = 0x8L,
+      BIND_SUBPASS_INPUT = 0x10L,
       BIND_FORCE_UINT = 0xffffffff
     };
 
   public:
     struct Range
     {
-      uint32_t offset{ 0u };
-      uint32_t length{ 0u };
+      uint64_t offset{ 0u }; // bytes for buffers
+      uint64_t length{ 0u };
     };
    
   protected:
@@ -86,8 +87,8 @@ namespace RayGene3D
     View(const std::string& name,
       Resource& resource,
       Usage usage,
-      const View::Range& mipmaps_or_count = Range{ 0, uint32_t(-1) },
-      const View::Range& layers_or_stride = Range{ 0, uint32_t(-1) },
+      const View::Range& mipmaps_or_count = Range{ 0, uint64_t(-1) },
+      const View::Range& layers_or_stride = Range{ 0, uint64_t(-1) },
       View::Bind bind = View::BIND_UNKNOWN);
     virtual ~View();
   };
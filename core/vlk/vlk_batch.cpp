@@ -35,6 +35,11 @@ THE SOFTWARE.
 
 namespace RayGene3D
 {
+  const auto is_input = [](const VLKPass* pass, const std::shared_ptr<View>& view)
+  {
+    return pass->GetType() == Pass::TYPE_GRAPHIC && (view->GetBind() & View::BIND_SUBPASS_INPUT) != 0;
+  };
+
   void VLKBatch::Initialize()
   {
     auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
@@ -135,6 +140,14 @@ namespace RayGene3D
         vkGetAccelerationStructureBuildSizesKHR = reinterpret_cast<PFN_vkGetAccelerationStructureBuildSizesKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkGetAccelerationStructureBuildSizesKHR"));
         vkCmdBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkCmdBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkCmdBuildAccelerationStructuresKHR"));
         vkDestroyAccelerationStructureKHR = reinterpret_cast<PFN_vkDestroyAccelerationStructureKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkDestroyAccelerationStructureKHR"));
+        vkCmdWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkCmdWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkCmdWriteAccelerationStructuresPropertiesKHR"));
+        vkCmdCopyAccelerationStructureToMemoryKHR = reinterpret_cast<PFN_vkCmdCopyAccelerationStructureToMemoryKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkCmdCopyAccelerationStructureToMemoryKHR"));
+        vkCmdCopyMemoryToAccelerationStructureKHR = reinterpret_cast<PFN_vkCmdCopyMemoryToAccelerationStructureKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkCmdCopyMemoryToAccelerationStructureKHR"));
+        vkGetDeviceAccelerationStructureCompatibilityKHR = reinterpret_cast<PFN_vkGetDeviceAccelerationStructureCompatibilityKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkGetDeviceAccelerationStructureCompatibilityKHR"));
+        vkBuildAccelerationStructuresKHR = reinterpret_cast<PFN_vkBuildAccelerationStructuresKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkBuildAccelerationStructuresKHR"));
+        vkCopyAccelerationStructureToMemoryKHR = reinterpret_cast<PFN_vkCopyAccelerationStructureToMemoryKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkCopyAccelerationStructureToMemoryKHR"));
+        vkCopyMemoryToAccelerationStructureKHR = reinterpret_cast<PFN_vkCopyMemoryToAccelerationStructureKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkCopyMemoryToAccelerationStructureKHR"));
+        vkWriteAccelerationStructuresPropertiesKHR = reinterpret_cast<PFN_vkWriteAccelerationStructuresPropertiesKHR>(vkGetDeviceProcAddr(device->GetDevice(), "vkWriteAccelerationStructuresPropertiesKHR"));
       }
 
       {
@@ -144,236 +157,15 @@ namespace RayGene3D
         allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
         allocate_info.commandBufferCount = 1;
         BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device->GetDevice(), &allocate_info, &command_buffer));
-
-        VkFenceCreateInfo create_info = {};
-        create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-        BLAST_ASSERT(VK_SUCCESS == vkCreateFence(device->GetDevice(), &create_info, nullptr, &fence));
       }
 
-      VkCommandBufferBeginInfo beginInfo = {};
-      beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-      BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &beginInfo));
+      GroupEntities();
 
+      if (!device->GetHostBuild() || !BuildOnHost())
       {
-        blas_memories.resize(entities.size());
-        blas_buffers.resize(entities.size());
-        blas_items.resize(entities.size());
-
-        for (auto i = 0u; i < uint32_t(entities.size()); ++i)
-        {
-          auto& blas_memory = blas_memories[i];
-          auto& blas_buffer = blas_buffers[i];
-          auto& blas_item = blas_items[i];
-
-          const auto& chunk = entities[i];
-
-          const auto vtx_resource = reinterpret_cast<VLKResource*>(&chunk.va_views[0]->GetResource());
-          const auto vtx_stride = vtx_resource->GetLayersOrStride();
-          const auto vtx_count = chunk.vtx_or_grid_y.length;
-          const auto vtx_offset = chunk.vtx_or_grid_y.offset;
-          const auto vtx_address = device->GetAddress(vtx_resource->GetBuffer());
-
-          const auto idx_resource = reinterpret_cast<VLKResource*>(&chunk.ia_views[0]->GetResource());
-          const auto idx_stride = idx_resource->GetLayersOrStride();
-          const auto idx_count = chunk.idx_or_grid_z.length;
-          const auto idx_offset = chunk.idx_or_grid_z.offset;
-          const auto idx_address = device->GetAddress(idx_resource->GetBuffer());
-
-          //BLAST_LOG("Vertices and Triangles count/offset: %d/%d, %d/%d", va_count, va_offset, ia_count, ia_offset);
-
-          VkAccelerationStructureGeometryKHR structure_geometry{};
-          structure_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-          structure_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
-          structure_geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
-          structure_geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
-          structure_geometry.geometry.triangles.vertexData.deviceAddress = vtx_address;
-          structure_geometry.geometry.triangles.vertexStride = vtx_stride;
-          structure_geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
-          structure_geometry.geometry.triangles.maxVertex = vtx_count - 1;
-          structure_geometry.geometry.triangles.indexData.deviceAddress = idx_address;
-          structure_geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
-
-          VkAccelerationStructureBuildRangeInfoKHR range_info{};
-          range_info.primitiveCount = idx_count / 3;
-          range_info.primitiveOffset = idx_offset * idx_stride / 3; //byte offset
-          range_info.firstVertex = vtx_offset;
-          range_info.transformOffset = 0;
-
-          VkAccelerationStructureBuildGeometryInfoKHR geometry_info{};
-          geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-          geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-          geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-          geometry_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-          geometry_info.geometryCount = 1;
-          geometry_info.pGeometries = &structure_geometry;
-          geometry_info.scratchData.deviceAddress = device->GetScratchAddress();;
-
-          VkAccelerationStructureBuildSizesInfoKHR sizes_info{};
-          sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-          vkGetAccelerationStructureBuildSizesKHR(device->GetDevice(),
-            VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-            &geometry_info,
-            &range_info.primitiveCount,
-            &sizes_info);
-          BLAST_ASSERT(device->GetScratchSize() >= sizes_info.buildScratchSize);
-
-          {
-            const auto size = sizes_info.accelerationStructureSize;
-            const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR;
-            const auto buffer = device->CreateBuffer(size, usage);
-            const auto requirements = device->GetRequirements(buffer);
-            const auto flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-            const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
-            const auto memory = device->AllocateMemory(requirements.size, index, true);
-
-            BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
-
-            blas_buffer = buffer;
-            blas_memory = memory;
-          }
-
-          VkAccelerationStructureCreateInfoKHR create_info{};
-          create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-          create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
-          create_info.size = sizes_info.accelerationStructureSize;
-          create_info.buffer = blas_buffer;
-          BLAST_ASSERT(VK_SUCCESS == vkCreateAccelerationStructureKHR(device->GetDevice(), &create_info, nullptr, &blas_item));
-
-          geometry_info.dstAccelerationStructure = blas_item;
-
-          const VkAccelerationStructureBuildRangeInfoKHR* range_info_ptr = &range_info;
-          vkCmdBuildAccelerationStructuresKHR(command_buffer, 1, &geometry_info, &range_info_ptr);
-
-          VkMemoryBarrier memory_barrier = {};
-          memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-          memory_barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
-          memory_barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
-          vkCmdPipelineBarrier(command_buffer,
-            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-            VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-            0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
-        }
-      }
-
-      {
-        std::vector<VkAccelerationStructureInstanceKHR> instances(entities.size());
-
-        for (auto i = 0u; i < uint32_t(entities.size()); ++i)
-        {
-          VkAccelerationStructureDeviceAddressInfoKHR address_info{};
-          address_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
-          address_info.accelerationStructure = blas_items[i];
-          const auto blas_address = vkGetAccelerationStructureDeviceAddressKHR(device->GetDevice(), &address_info);
-
-          VkTransformMatrixKHR transformMatrix = {
-            1.0f, 0.0f, 0.0f, 0.0f,
-            0.0f, 1.0f, 0.0f, 0.0f,
-            0.0f, 0.0f, 1.0f, 0.0f
-          };
-
-          instances[i] = { transformMatrix, i, 0xFF, 0, VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR, blas_address };
-        }
-
-        {
-          const auto size = instances.size() * sizeof(VkAccelerationStructureInstanceKHR);
-          const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
-          const auto buffer = device->CreateBuffer(size, usage);
-          const auto requirements = device->GetRequirements(buffer);
-          const auto flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-          const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
-          const auto memory = device->AllocateMemory(requirements.size, index, true);
-
-          BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
-
-          instances_buffer = buffer;
-          instances_memory = memory;
-        }
-
-        {
-          void* mapped{ nullptr };
-          BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), instances_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
-          memcpy(mapped, instances.data(), instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
-          vkUnmapMemory(device->GetDevice(), instances_memory);
-        }
-
-        VkAccelerationStructureGeometryKHR structure_geometry{};
-        structure_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
-        structure_geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
-        structure_geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
-        structure_geometry.geometry.instances.data.deviceAddress = device->GetAddress(instances_buffer);
-
-        VkAccelerationStructureBuildRangeInfoKHR range_info{};
-        range_info.primitiveCount = uint32_t(instances.size());
-        range_info.primitiveOffset = 0;
-        range_info.firstVertex = 0;
-        range_info.transformOffset = 0;
-
-        VkAccelerationStructureBuildGeometryInfoKHR geometry_info{};
-        geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
-        geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-        geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
-        geometry_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
-        geometry_info.geometryCount = 1;
-        geometry_info.pGeometries = &structure_geometry;
-        geometry_info.scratchData.deviceAddress = device->GetScratchAddress();
-
-        VkAccelerationStructureBuildSizesInfoKHR sizes_info{};
-        sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
-        vkGetAccelerationStructureBuildSizesKHR(device->GetDevice(),
-          VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
-          &geometry_info,
-          &range_info.primitiveCount,
-          &sizes_info);
-        BLAST_ASSERT(device->GetScratchSize() >= sizes_info.buildScratchSize);
-
-        {
-          const auto size = sizes_info.accelerationStructureSize;
-          const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR;
-          const auto buffer = device->CreateBuffer(size, usage);
-          const auto requirements = device->GetRequirements(buffer);
-          const auto flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-          const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
-          const auto memory = device->AllocateMemory(requirements.size, index, true);
-
-          BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
-
-          tlas_buffer = buffer;
-          tlas_memory = memory;
-        }
-
-        VkAccelerationStructureCreateInfoKHR create_info = {};
-        create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
-        create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
-        create_info.size = sizes_info.accelerationStructureSize;
-        create_info.buffer = tlas_buffer;
-        BLAST_ASSERT(VK_SUCCESS == vkCreateAccelerationStructureKHR(device->GetDevice(), &create_info, nullptr, &tlas_item));
-
-        geometry_info.dstAccelerationStructure = tlas_item;
-
-        const VkAccelerationStructureBuildRangeInfoKHR* range_info_ptr = &range_info;
-        vkCmdBuildAccelerationStructuresKHR(command_buffer, 1, &geometry_info, &range_info_ptr);
-
-        VkMemoryBarrier memory_barrier = {};
-        memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-        memory_barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
-        memory_barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
-        vkCmdPipelineBarrier(command_buffer,
-          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
-          0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+        BuildOnDevice();
       }
 
-      BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
-
-      VkSubmitInfo submit_info = {};
-      submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-      submit_info.commandBufferCount = 1;
-      submit_info.pCommandBuffers = &command_buffer;
-
-      BLAST_ASSERT(VK_SUCCESS == vkQueueSubmit(device->GetQueue(), 1, &submit_info, VK_NULL_HANDLE)); // fence));
-      BLAST_ASSERT(VK_SUCCESS == vkQueueWaitIdle(device->GetQueue()));
-
       as_items.push_back(tlas_item);
     }
     
@@ -386,7 +178,9 @@ namespace RayGene3D
       if (!samplers.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_SAMPLER, uint32_t(samplers.size()) }); }
       if (!ub_views.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uint32_t(ub_views.size()) }); }
       if (!sb_views.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, uint32_t(sb_views.size()) }); }
-      if (!ri_views.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, uint32_t(ri_views.size()) }); }
+      const auto in_count = uint32_t(std::count_if(ri_views.begin(), ri_views.end(), [pass](const std::shared_ptr<View>& view) { return is_input(pass, view); }));
+      if (ri_views.size() > in_count) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, uint32_t(ri_views.size()) - in_count }); }
+      if (in_count > 0) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, in_count }); }
       if (!rb_views.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uint32_t(rb_views.size()) }); }
       if (!wi_views.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, uint32_t(wi_views.size()) }); }
       if (!wb_views.empty()) { pool_sizes.push_back({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, uint32_t(wb_views.size()) }); }
@@ -473,6 +267,13 @@ namespace RayGene3D
           descriptor.pImmutableSamplers = nullptr;
           descriptor.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT
             | VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR;
+
+          // Input attachments are read by fragment shaders only
+          if (is_input(pass, ri_views.at(i)))
+          {
+            descriptor.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+            descriptor.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+          }
         }
         bindings.insert(bindings.end(), descriptors.begin(), descriptors.end());
       }
@@ -550,6 +351,155 @@ namespace RayGene3D
     }
 
 
+    UpdateSets();
+
+    UpdatePipeline();
+
+    if (pass->GetType() == Pass::TYPE_COMPUTE)
+    {
+      VkComputePipelineCreateInfo create_info = {};
+      create_info.sType               = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+      create_info.flags               = 0;
+      create_info.stage               = config->GetStageArray()[0];
+      create_info.layout              = layout;
+      create_info.basePipelineHandle  = VK_NULL_HANDLE;
+      create_info.basePipelineIndex   = -1;
+      BLAST_ASSERT(VK_SUCCESS == vkCreateComputePipelines(device->GetDevice(), VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+    }
+
+    if (pass->GetType() == Pass::TYPE_TRACING && device->GetRayTracingSupported())
+    {
+      VkRayTracingPipelineCreateInfoKHR create_info = {};
+      create_info.sType                         = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
+      create_info.flags                         = 0;
+      create_info.stageCount                    = config->GetStageCount();
+      create_info.pStages                       = config->GetStageArray();
+      create_info.groupCount                    = config->GetGroupCount();
+      create_info.pGroups                       = config->GetGroupArray();
+      create_info.maxPipelineRayRecursionDepth  = 1;
+      create_info.layout                        = layout;
+      create_info.basePipelineHandle            = VK_NULL_HANDLE;
+      BLAST_ASSERT(VK_SUCCESS == vkCreateRayTracingPipelinesKHR(device->GetDevice(), {}, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+
+      const auto& tracing = device->GetTracingProperties();
+      const auto handle_size = tracing.shaderGroupHandleSize;
+      const auto handle_align = std::max(1u, tracing.shaderGroupHandleAlignment);
+      const auto base_align = std::max(1u, tracing.shaderGroupBaseAlignment);
+      const auto align_fn = [](VkDeviceSize size, VkDeviceSize align) { return (size + align - 1) / align * align; };
+
+      const auto& miss_groups = config->GetMissGroups();
+      const auto& xhit_groups = config->GetXHitGroups();
+      const auto& proc_groups = config->GetProcGroups();
+      const auto& call_groups = config->GetCallGroups();
+
+      // Every entity owns one hit record, push data goes inline after the handle and is read
+      // through shaderRecordEXT, instances point at the record of their first entity
+      auto record_size = VkDeviceSize(0);
+      for (const auto& entity : entities)
+      {
+        if (entity.push_data) record_size = sizeof(PushData::value_type);
+      }
+
+      const auto general_stride = align_fn(handle_size, handle_align);
+      const auto xhit_stride = align_fn(handle_size + record_size, handle_align);
+      BLAST_ASSERT(xhit_stride <= tracing.maxShaderGroupStride);
+
+      const auto rgen_size = miss_groups.first > 0 ? align_fn(handle_size, base_align) : 0;
+      const auto miss_size = align_fn(miss_groups.second * general_stride, base_align);
+      const auto xhit_count = xhit_groups.second + proc_groups.second > 0 ? uint32_t(entities.size()) : 0u;
+      const auto xhit_size = align_fn(xhit_count * xhit_stride, base_align);
+      const auto call_size = align_fn(call_groups.second * general_stride, base_align);
+
+      const auto rgen_offset = VkDeviceSize(0);
+      const auto miss_offset = rgen_offset + rgen_size;
+      const auto xhit_offset = miss_offset + miss_size;
+      const auto call_offset = xhit_offset + xhit_size;
+      const auto table_size = call_offset + call_size;
+
+      {
+        const auto size = table_size + base_align;
+        const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR;
+        const auto buffer = device->CreateBuffer(size, usage);
+        const auto requirements = device->GetRequirements(buffer);
+        const auto property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        const auto index = device->GetMemoryIndex(property, requirements.memoryTypeBits);
+        const auto memory = device->AllocateMemory(requirements.size, index, true, VLKDevice::CATEGORY_TABLE, name);
+
+        BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+        table_buffer = buffer;
+        table_memory = memory;
+      }
+
+      // Buffer address is only guaranteed the memory alignment, regions are shifted to the base alignment
+      const auto table_address = align_fn(device->GetAddress(table_buffer), base_align);
+      const auto table_shift = table_address - device->GetAddress(table_buffer);
+
+      std::vector<uint8_t> handles(config->GetGroupCount() * handle_size);
+      BLAST_ASSERT(VK_SUCCESS == vkGetRayTracingShaderGroupHandlesKHR(device->GetDevice(), pipeline, 0,
+        config->GetGroupCount(), handles.size(), handles.data()));
+
+      uint8_t* mapped = nullptr;
+      BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), table_memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
+      mapped += table_shift;
+      memset(mapped, 0, table_size);
+
+      if (rgen_size > 0)
+      {
+        memcpy(mapped + rgen_offset, handles.data(), handle_size);
+      }
+
+      for (uint32_t i = 0; i < miss_groups.second; ++i)
+      {
+        memcpy(mapped + miss_offset + i * general_stride, handles.data() + (miss_groups.first + i) * handle_size, handle_size);
+      }
+
+      for (uint32_t i = 0; i < xhit_count; ++i)
+      {
+        const auto& entity = entities[i];
+        const auto& hit_groups = entity.ia_views.empty() ? proc_groups : xhit_groups;
+        BLAST_ASSERT(entity.hit_group < hit_groups.second);
+
+        const auto record = mapped + xhit_offset + i * xhit_stride;
+        memcpy(record, handles.data() + (hit_groups.first + entity.hit_group) * handle_size, handle_size);
+        if (entity.push_data)
+        {
+          memcpy(record + handle_size, entity.push_data.value().data(), entity.push_data.value().size());
+        }
+      }
+
+      for (uint32_t i = 0; i < call_groups.second; ++i)
+      {
+        memcpy(mapped + call_offset + i * general_stride, handles.data() + (call_groups.first + i) * handle_size, handle_size);
+      }
+
+      vkUnmapMemory(device->GetDevice(), table_memory);
+
+      BLAST_LOG("RTX binding table: %d miss, %d hit, %d call records, %d bytes [%s]",
+        miss_groups.second, xhit_count, call_groups.second, uint32_t(table_size), name.c_str());
+
+      if (rgen_size > 0)
+        rgen_region = { table_address + rgen_offset, rgen_size, rgen_size };
+      if (miss_groups.second > 0)
+        miss_region = { table_address + miss_offset, general_stride, miss_groups.second * general_stride };
+      if (xhit_count > 0)
+        xhit_region = { table_address + xhit_offset, xhit_stride, xhit_count * xhit_stride };
+      if (call_groups.second > 0)
+        call_region = { table_address + call_offset, general_stride, call_groups.second * general_stride };
+    }
+  }
+
+  void VLKBatch::UpdateSets()
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    // Transient images get their views once placed, the sets are written from there
+    const auto placed_fn = [](const std::shared_ptr<View>& view) { return (reinterpret_cast<VLKView*>(view.get()))->GetView() != nullptr; };
+    if (!std::all_of(ri_views.begin(), ri_views.end(), placed_fn)) return;
+    if (!std::all_of(wi_views.begin(), wi_views.end(), placed_fn)) return;
+
     uint32_t write_offset = 0;
 
     if(samplers.size() > 0)
@@ -587,7 +537,7 @@ namespace RayGene3D
         auto& buffer_info = buffer_infos.at(i);
         buffer_info.buffer = (reinterpret_cast<VLKResource*>(&ub_views.at(i)->GetResource()))->GetBuffer();
         buffer_info.offset = ub_views.at(i)->GetMipmapsOrCount().offset;        
-        buffer_info.range = ub_views.at(i)->GetMipmapsOrCount().length == uint32_t(-1) ? VK_WHOLE_SIZE : ub_views.at(i)->GetMipmapsOrCount().length;
+        buffer_info.range = ub_views.at(i)->GetMipmapsOrCount().length == uint64_t(-1) ? VK_WHOLE_SIZE : ub_views.at(i)->GetMipmapsOrCount().length;
 
         auto& descriptor = descriptors.at(i);
         descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -613,7 +563,7 @@ namespace RayGene3D
         auto& buffer_info = buffer_infos.at(i);
         buffer_info.buffer = (reinterpret_cast<VLKResource*>(&sb_views.at(i)->GetResource()))->GetBuffer();
         buffer_info.offset = sb_views.at(i)->GetMipmapsOrCount().offset;
-        buffer_info.range = sb_views.at(i)->GetMipmapsOrCount().length == uint32_t(-1) ? VK_WHOLE_SIZE : sb_views.at(i)->GetMipmapsOrCount().length;
+        buffer_info.range = sb_views.at(i)->GetMipmapsOrCount().length == uint64_t(-1) ? VK_WHOLE_SIZE : sb_views.at(i)->GetMipmapsOrCount().length;
 
         auto& descriptor = descriptors.at(i);
         descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -665,7 +615,8 @@ namespace RayGene3D
         auto& image_info = image_infos.at(i);
         image_info.sampler = nullptr;
         image_info.imageView = (reinterpret_cast<VLKView*>(ri_views.at(i).get()))->GetView();
-        image_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        image_info.imageLayout = is_input(pass, ri_views.at(i)) ? pass->GetInputLayout(ri_views.at(i))
+          : (reinterpret_cast<VLKResource*>(&ri_views.at(i)->GetResource()))->GetShaderLayout();
 
         auto& descriptor = descriptors.at(i);
         descriptor.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -673,7 +624,7 @@ namespace RayGene3D
         descriptor.dstBinding = i + write_offset;
         descriptor.dstArrayElement = 0;
         descriptor.descriptorCount = 1;
-        descriptor.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+        descriptor.descriptorType = is_input(pass, ri_views.at(i)) ? VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
         descriptor.pImageInfo = &image_info;
         descriptor.pBufferInfo = nullptr;
         descriptor.pTexelBufferView = nullptr;
@@ -763,8 +714,37 @@ namespace RayGene3D
     }
 
     BLAST_LOG("Binding count: %d [%s]", write_offset, name.c_str());
+  }
+
+  const void* VLKBatch::GetHostData(Resource& resource, size_t offset, size_t size)
+  {
+    for (uint32_t i = 0; i < resource.GetInteropCount(); ++i)
+    {
+      const auto interop = resource.GetInteropItem(i);
+      if (offset < interop.second)
+      {
+        return interop.first && offset + size <= interop.second ? reinterpret_cast<const uint8_t*>(interop.first) + offset : nullptr;
+      }
+      offset -= interop.second;
+    }
+    return nullptr;
+  }
+
+  void VLKBatch::UpdatePipeline()
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    if (pass->GetType() != Pass::TYPE_GRAPHIC) return;
+
+    // Graphic pipelines are tied to the render pass and subpass the pass is merged into
+    if (pipeline)
+    {
+      vkDestroyPipeline(device->GetDevice(), pipeline, nullptr);
+      pipeline = nullptr;
+    }
 
-    if (pass->GetType() == Pass::TYPE_GRAPHIC)
     {
       VkGraphicsPipelineCreateInfo create_info = {};
       create_info.sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -782,78 +762,892 @@ namespace RayGene3D
       create_info.pDynamicState       = nullptr;
       create_info.layout              = layout;
       create_info.renderPass          = pass->GetRenderPass();
-      create_info.subpass             = 0;
+      create_info.subpass             = pass->GetSubpass();
       create_info.basePipelineHandle  = VK_NULL_HANDLE;
       create_info.basePipelineIndex   = -1;
       BLAST_ASSERT(VK_SUCCESS == vkCreateGraphicsPipelines(device->GetDevice(), VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
     }
+  }
 
-    if (pass->GetType() == Pass::TYPE_COMPUTE)
+  void VLKBatch::GroupEntities()
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    // Consecutive entities share one multi-geometry bottom level until the primitive budget is
+    // exceeded, a zero budget keeps one bottom level per entity, triangles and boxes never mix
+    const auto budget = uint64_t(device->GetGeometryBudget());
+    const auto limit = std::max(uint64_t(1), uint64_t(device->GetAccelerationProperties().maxGeometryCount));
+
+    blas_groups.clear();
+
+    auto triangles = uint64_t(0);
+    for (auto i = 0u; i < uint32_t(entities.size()); ++i)
     {
-      VkComputePipelineCreateInfo create_info = {};
-      create_info.sType               = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-      create_info.flags               = 0;
-      create_info.stage               = config->GetStageArray()[0];
-      create_info.layout              = layout;
-      create_info.basePipelineHandle  = VK_NULL_HANDLE;
-      create_info.basePipelineIndex   = -1;
-      BLAST_ASSERT(VK_SUCCESS == vkCreateComputePipelines(device->GetDevice(), VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+      const auto procedural = entities[i].ia_views.empty();
+      const auto count = uint64_t(procedural ? entities[i].vtx_or_grid_y.length : entities[i].idx_or_grid_z.length / 3);
+      if (blas_groups.empty() || budget == 0 || triangles + count > budget || blas_groups.back().second >= limit
+        || entities[blas_groups.back().first].ia_views.empty() != procedural)
+      {
+        blas_groups.push_back({ i, 0 });
+        triangles = 0;
+      }
+      blas_groups.back().second += 1;
+      triangles += count;
     }
+  }
 
-    if (pass->GetType() == Pass::TYPE_TRACING && device->GetRayTracingSupported())
+  bool VLKBatch::BuildOnHost()
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    if (!device->GetHostBuildSupported()) return false;
+
+    // Host builds read geometry straight from interop data, so every range has to stay inside one interop item
+    std::vector<std::pair<const void*, const void*>> datas(entities.size());
+    for (auto i = 0u; i < uint32_t(entities.size()); ++i)
     {
-      VkRayTracingPipelineCreateInfoKHR create_info = {};
-      create_info.sType                         = VK_STRUCTURE_TYPE_RAY_TRACING_PIPELINE_CREATE_INFO_KHR;
-      create_info.flags                         = 0;
-      create_info.stageCount                    = config->GetStageCount();
-      create_info.pStages                       = config->GetStageArray();
-      create_info.groupCount                    = config->GetGroupCount();
-      create_info.pGroups                       = config->GetGroupArray();
-      create_info.maxPipelineRayRecursionDepth  = 1;
-      create_info.layout                        = layout;
-      create_info.basePipelineHandle            = VK_NULL_HANDLE;
-      BLAST_ASSERT(VK_SUCCESS == vkCreateRayTracingPipelinesKHR(device->GetDevice(), {}, VK_NULL_HANDLE, 1, &create_info, nullptr, &pipeline));
+      const auto& chunk = entities[i];
 
-      const auto binding_size = device->GetTracingProperties().shaderGroupHandleSize;
-      const auto binding_align = device->GetTracingProperties().shaderGroupBaseAlignment;
+      auto& vtx_resource = chunk.va_views[0]->GetResource();
+      const auto vtx_stride = vtx_resource.GetLayersOrStride();
+      datas[i].first = GetHostData(vtx_resource, size_t(chunk.vtx_or_grid_y.offset) * vtx_stride, size_t(chunk.vtx_or_grid_y.length) * vtx_stride);
+      if (datas[i].first == nullptr) return false;
+
+      if (chunk.ia_views.empty()) continue;
+
+      auto& idx_resource = chunk.ia_views[0]->GetResource();
+      const auto idx_stride = idx_resource.GetLayersOrStride();
+      datas[i].second = GetHostData(idx_resource, size_t(chunk.idx_or_grid_z.offset) * idx_stride / 3, size_t(chunk.idx_or_grid_z.length) * idx_stride / 3);
+      if (datas[i].second == nullptr) return false;
+    }
 
+    const auto create_fn = [this, device](VkAccelerationStructureTypeKHR type, VkDeviceSize size, VkDeviceMemory& as_memory, VkBuffer& as_buffer, VkAccelerationStructureKHR& as_item)
+    {
       {
-        const auto size = config->GetGroupCount() * binding_align;
-        const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_SHADER_BINDING_TABLE_BIT_KHR;
+        const auto usage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR;
         const auto buffer = device->CreateBuffer(size, usage);
         const auto requirements = device->GetRequirements(buffer);
-        const auto property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        const auto index = device->GetMemoryIndex(property, requirements.memoryTypeBits);
-        const auto memory = device->AllocateMemory(requirements.size, index, true);
+        const auto flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
+        const auto memory = device->AllocateMemory(requirements.size, index, false, VLKDevice::CATEGORY_STRUCTURE, name);
 
         BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
 
-        table_buffer = buffer;
-        table_memory = memory;
+        as_buffer = buffer;
+        as_memory = memory;
       }
 
-      auto* binding_data = new uint8_t[config->GetGroupCount() * binding_align];
-      BLAST_ASSERT(VK_SUCCESS == vkGetRayTracingShaderGroupHandlesKHR(device->GetDevice(), pipeline, 0, 
-        config->GetGroupCount(), config->GetGroupCount() * binding_align, binding_data));
+      VkAccelerationStructureCreateInfoKHR create_info{};
+      create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+      create_info.type = type;
+      create_info.size = size;
+      create_info.buffer = as_buffer;
+      BLAST_ASSERT(VK_SUCCESS == vkCreateAccelerationStructureKHR(device->GetDevice(), &create_info, nullptr, &as_item));
+    };
+
+    blas_memories.resize(blas_groups.size());
+    blas_buffers.resize(blas_groups.size());
+    blas_items.resize(blas_groups.size());
+
+    std::vector<VkAccelerationStructureGeometryKHR> blas_geometries(entities.size());
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> blas_ranges(entities.size());
+    std::vector<uint32_t> blas_counts(entities.size());
+    std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> blas_pointers(blas_groups.size());
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> blas_infos(blas_groups.size());
+    std::vector<std::vector<uint8_t>> blas_scratches(blas_groups.size());
+
+    for (auto i = 0u; i < uint32_t(entities.size()); ++i)
+    {
+      const auto& chunk = entities[i];
 
-      uint8_t* mapped = nullptr;
-      BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), table_memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped));
-      for (uint32_t i = 0; i < config->GetGroupCount(); ++i)
+      auto& structure_geometry = blas_geometries[i];
+      structure_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+      structure_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+      if (chunk.ia_views.empty())
+      {
+        // Boxes are read as VkAabbPositionsKHR, stride and address have to keep them 8 bytes aligned
+        const auto aabb_stride = chunk.va_views[0]->GetResource().GetLayersOrStride();
+        BLAST_ASSERT(aabb_stride % 8 == 0 && reinterpret_cast<uintptr_t>(datas[i].first) % 8 == 0);
+
+        structure_geometry.geometryType = VK_GEOMETRY_TYPE_AABBS_KHR;
+        structure_geometry.geometry.aabbs.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_AABBS_DATA_KHR;
+        structure_geometry.geometry.aabbs.data.hostAddress = datas[i].first;
+        structure_geometry.geometry.aabbs.stride = aabb_stride;
+      }
+      else
       {
-        memcpy(mapped + i * binding_align, binding_data + i * binding_size, binding_size);
+        structure_geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+        structure_geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+        structure_geometry.geometry.triangles.vertexData.hostAddress = datas[i].first;
+        structure_geometry.geometry.triangles.vertexStride = chunk.va_views[0]->GetResource().GetLayersOrStride();
+        structure_geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+        structure_geometry.geometry.triangles.maxVertex = chunk.vtx_or_grid_y.length - 1;
+        structure_geometry.geometry.triangles.indexData.hostAddress = datas[i].second;
+        structure_geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+      }
 
-        const auto temp = reinterpret_cast<const uint64_t*>(mapped + i * binding_align);
-        BLAST_LOG("RTX shader handle %d: %ld %ld %ld %ld", i, temp[0], temp[1], temp[2], temp[3]);
+      auto& range_info = blas_ranges[i];
+      range_info.primitiveCount = chunk.ia_views.empty() ? chunk.vtx_or_grid_y.length : chunk.idx_or_grid_z.length / 3;
+      range_info.primitiveOffset = 0;
+      range_info.firstVertex = 0;
+      range_info.transformOffset = 0;
+      blas_counts[i] = range_info.primitiveCount;
+    }
+
+    std::vector<uint32_t> blas_builds;
+    std::vector<CacheItem> downloads;
+
+    for (auto g = 0u; g < uint32_t(blas_groups.size()); ++g)
+    {
+      const auto& group = blas_groups[g];
+
+      CacheItem cache_item{ g };
+      cache_item.path = GetCachePath(group.first, group.second, cache_item.key);
+      std::vector<uint8_t> cache_data;
+      if (!cache_item.path.empty() && LoadCache(cache_item.path, cache_item.key, cache_data))
+      {
+        const auto deserialized_size = reinterpret_cast<const uint64_t*>(cache_data.data() + 2 * VK_UUID_SIZE)[1];
+        create_fn(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, deserialized_size, blas_memories[g], blas_buffers[g], blas_items[g]);
+
+        VkCopyMemoryToAccelerationStructureInfoKHR copy_info{};
+        copy_info.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR;
+        copy_info.src.hostAddress = cache_data.data();
+        copy_info.dst = blas_items[g];
+        copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+        BLAST_ASSERT(VK_SUCCESS == device->Defer([this, device, &copy_info](VkDeferredOperationKHR operation)
+        {
+          return vkCopyMemoryToAccelerationStructureKHR(device->GetDevice(), operation, &copy_info);
+        }));
+
+        BLAST_LOG("Loading acceleration structure %d from cache [%s]", g, cache_item.path.c_str());
+        continue;
       }
-      vkUnmapMemory(device->GetDevice(), table_memory);
-      delete[] binding_data;
-
-      if (config->GetGroupCount() > 0)
-        rgen_region = { device->GetAddress(table_buffer) + 0 * binding_align, binding_align, binding_align };
-      if (config->GetGroupCount() > 1)
-        miss_region = { device->GetAddress(table_buffer) + 1 * binding_align, binding_align, binding_align };
-      if (config->GetGroupCount() > 2)
-        xhit_region = { device->GetAddress(table_buffer) + 2 * binding_align, binding_align, binding_align };
+
+      auto& geometry_info = blas_infos[g];
+      geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+      geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+      geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+      geometry_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+      geometry_info.geometryCount = group.second;
+      geometry_info.pGeometries = &blas_geometries[group.first];
+      blas_pointers[g] = &blas_ranges[group.first];
+
+      VkAccelerationStructureBuildSizesInfoKHR sizes_info{};
+      sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+      vkGetAccelerationStructureBuildSizesKHR(device->GetDevice(),
+        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR,
+        &geometry_info,
+        &blas_counts[group.first],
+        &sizes_info);
+
+      create_fn(VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, sizes_info.accelerationStructureSize, blas_memories[g], blas_buffers[g], blas_items[g]);
+
+      blas_scratches[g].resize(size_t(sizes_info.buildScratchSize));
+      geometry_info.scratchData.hostAddress = blas_scratches[g].data();
+      geometry_info.dstAccelerationStructure = blas_items[g];
+      blas_builds.push_back(g);
+
+      if (!cache_item.path.empty())
+      {
+        downloads.push_back(std::move(cache_item));
+      }
+    }
+
+    if (!blas_builds.empty())
+    {
+      std::vector<VkAccelerationStructureBuildGeometryInfoKHR> build_infos(blas_builds.size());
+      std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> build_pointers(blas_builds.size());
+      for (auto i = 0u; i < uint32_t(blas_builds.size()); ++i)
+      {
+        build_infos[i] = blas_infos[blas_builds[i]];
+        build_pointers[i] = blas_pointers[blas_builds[i]];
+      }
+
+      BLAST_ASSERT(VK_SUCCESS == device->Defer([this, device, &build_infos, &build_pointers](VkDeferredOperationKHR operation)
+      {
+        return vkBuildAccelerationStructuresKHR(device->GetDevice(), operation, uint32_t(build_infos.size()), build_infos.data(), build_pointers.data());
+      }));
+    }
+    blas_scratches.clear();
+
+    // Host built structures are serialized in place, no query pool or readback buffer is involved
+    if (!downloads.empty())
+    {
+      std::vector<VkAccelerationStructureKHR> items(downloads.size());
+      for (auto i = 0u; i < uint32_t(downloads.size()); ++i)
+      {
+        items[i] = blas_items[downloads[i].group];
+      }
+
+      std::vector<uint64_t> sizes(downloads.size());
+      BLAST_ASSERT(VK_SUCCESS == vkWriteAccelerationStructuresPropertiesKHR(device->GetDevice(), uint32_t(items.size()), items.data(),
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, sizes.size() * sizeof(uint64_t), sizes.data(), sizeof(uint64_t)));
+
+      for (auto i = 0u; i < uint32_t(downloads.size()); ++i)
+      {
+        std::vector<uint8_t> serialized(size_t(sizes[i]));
+
+        VkCopyAccelerationStructureToMemoryInfoKHR copy_info{};
+        copy_info.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR;
+        copy_info.src = items[i];
+        copy_info.dst.hostAddress = serialized.data();
+        copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+        BLAST_ASSERT(VK_SUCCESS == device->Defer([this, device, &copy_info](VkDeferredOperationKHR operation)
+        {
+          return vkCopyAccelerationStructureToMemoryKHR(device->GetDevice(), operation, &copy_info);
+        }));
+
+        StoreCache(downloads[i], serialized.data(), serialized.size());
+      }
+    }
+
+    std::vector<VkAccelerationStructureInstanceKHR> instances(blas_groups.size());
+    for (auto g = 0u; g < uint32_t(blas_groups.size()); ++g)
+    {
+      VkTransformMatrixKHR transformMatrix = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f
+      };
+
+      // Host built instances reference bottom levels by handle instead of device address
+      instances[g] = { transformMatrix, blas_groups[g].first, 0xFF, blas_groups[g].first, VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR, (uint64_t)blas_items[g] };
+    }
+
+    VkAccelerationStructureGeometryKHR tlas_geometry{};
+    tlas_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+    tlas_geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+    tlas_geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+    tlas_geometry.geometry.instances.data.hostAddress = instances.data();
+
+    VkAccelerationStructureBuildRangeInfoKHR tlas_range{};
+    tlas_range.primitiveCount = uint32_t(instances.size());
+    const VkAccelerationStructureBuildRangeInfoKHR* tlas_pointer = &tlas_range;
+
+    VkAccelerationStructureBuildGeometryInfoKHR tlas_info{};
+    tlas_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+    tlas_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+    tlas_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+    tlas_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+    tlas_info.geometryCount = 1;
+    tlas_info.pGeometries = &tlas_geometry;
+
+    VkAccelerationStructureBuildSizesInfoKHR sizes_info{};
+    sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+    vkGetAccelerationStructureBuildSizesKHR(device->GetDevice(),
+      VK_ACCELERATION_STRUCTURE_BUILD_TYPE_HOST_KHR,
+      &tlas_info,
+      &tlas_range.primitiveCount,
+      &sizes_info);
+
+    create_fn(VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, sizes_info.accelerationStructureSize, tlas_memory, tlas_buffer, tlas_item);
+
+    std::vector<uint8_t> tlas_scratch(size_t(sizes_info.buildScratchSize));
+    tlas_info.scratchData.hostAddress = tlas_scratch.data();
+    tlas_info.dstAccelerationStructure = tlas_item;
+
+    BLAST_ASSERT(VK_SUCCESS == device->Defer([this, device, &tlas_info, &tlas_pointer](VkDeferredOperationKHR operation)
+    {
+      return vkBuildAccelerationStructuresKHR(device->GetDevice(), operation, 1, &tlas_info, &tlas_pointer);
+    }));
+
+    BLAST_LOG("Building %d acceleration structures for %d entities on host [%s]",
+      uint32_t(blas_builds.size()), uint32_t(entities.size()), name.c_str());
+
+    return true;
+  }
+
+  void VLKBatch::BuildOnDevice()
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    std::vector<std::pair<VkBuffer, VkDeviceMemory>> uploads;
+    std::vector<CacheItem> downloads;
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &beginInfo));
+
+    std::vector<VkAccelerationStructureGeometryKHR> blas_geometries(entities.size());
+    std::vector<VkAccelerationStructureBuildRangeInfoKHR> blas_ranges(entities.size());
+    std::vector<uint32_t> blas_counts(entities.size());
+    std::vector<VkAccelerationStructureBuildGeometryInfoKHR> blas_infos(blas_groups.size());
+    std::vector<VkDeviceSize> blas_scratches(blas_groups.size(), 0);
+    std::vector<uint32_t> blas_builds;
+
+    {
+      blas_memories.resize(blas_groups.size());
+      blas_buffers.resize(blas_groups.size());
+      blas_items.resize(blas_groups.size());
+
+      const auto create_fn = [this, device](VkDeviceSize size, VkDeviceMemory& blas_memory, VkBuffer& blas_buffer, VkAccelerationStructureKHR& blas_item)
+      {
+        {
+          const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR;
+          const auto buffer = device->CreateBuffer(size, usage);
+          const auto requirements = device->GetRequirements(buffer);
+          const auto flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+          const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
+          const auto memory = device->AllocateMemory(requirements.size, index, true, VLKDevice::CATEGORY_STRUCTURE, name);
+
+          BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+          blas_buffer = buffer;
+          blas_memory = memory;
+        }
+
+        VkAccelerationStructureCreateInfoKHR create_info{};
+        create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+        create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+        create_info.size = size;
+        create_info.buffer = blas_buffer;
+        BLAST_ASSERT(VK_SUCCESS == vkCreateAccelerationStructureKHR(device->GetDevice(), &create_info, nullptr, &blas_item));
+      };
+
+      for (auto g = 0u; g < uint32_t(blas_groups.size()); ++g)
+      {
+        auto& blas_memory = blas_memories[g];
+        auto& blas_buffer = blas_buffers[g];
+        auto& blas_item = blas_items[g];
+
+        const auto& group = blas_groups[g];
+
+        CacheItem cache_item{ g };
+        cache_item.path = GetCachePath(group.first, group.second, cache_item.key);
+        std::vector<uint8_t> cache_data;
+        if (!cache_item.path.empty() && LoadCache(cache_item.path, cache_item.key, cache_data))
+        {
+          const auto deserialized_size = reinterpret_cast<const uint64_t*>(cache_data.data() + 2 * VK_UUID_SIZE)[1];
+          create_fn(deserialized_size, blas_memory, blas_buffer, blas_item);
+
+          const auto size = VkDeviceSize(cache_data.size());
+          const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+          const auto buffer = device->CreateBuffer(size, usage);
+          const auto requirements = device->GetRequirements(buffer);
+          const auto flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+          const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
+          const auto memory = device->AllocateMemory(requirements.size, index, true, VLKDevice::CATEGORY_STAGING, name);
+
+          BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+          void* mapped{ nullptr };
+          BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+          memcpy(mapped, cache_data.data(), cache_data.size());
+          vkUnmapMemory(device->GetDevice(), memory);
+
+          uploads.push_back({ buffer, memory });
+
+          VkCopyMemoryToAccelerationStructureInfoKHR copy_info{};
+          copy_info.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR;
+          copy_info.src.deviceAddress = device->GetAddress(buffer);
+          copy_info.dst = blas_item;
+          copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR;
+          vkCmdCopyMemoryToAccelerationStructureKHR(command_buffer, &copy_info);
+
+          BLAST_LOG("Loading acceleration structure %d from cache [%s]", g, cache_item.path.c_str());
+        }
+        else
+        {
+          // Geometries of a group keep their own buffers and offsets, hits are told apart by gl_GeometryIndexEXT
+          for (auto i = group.first; i < group.first + group.second; ++i)
+          {
+            const auto& chunk = entities[i];
+
+            const auto vtx_resource = reinterpret_cast<VLKResource*>(&chunk.va_views[0]->GetResource());
+            const auto vtx_stride = vtx_resource->GetLayersOrStride();
+            const auto vtx_count = chunk.vtx_or_grid_y.length;
+            const auto vtx_offset = chunk.vtx_or_grid_y.offset;
+            const auto vtx_address = device->GetAddress(vtx_resource->GetBuffer());
+
+            auto& structure_geometry = blas_geometries[i];
+            structure_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+            structure_geometry.flags = VK_GEOMETRY_OPAQUE_BIT_KHR;
+
+            auto& range_info = blas_ranges[i];
+            range_info.transformOffset = 0;
+
+            // Entities without index arrays are procedural, their vertex view holds VkAabbPositionsKHR boxes
+            if (chunk.ia_views.empty())
+            {
+              BLAST_ASSERT(vtx_stride % 8 == 0 && (vtx_address + vtx_offset * vtx_stride) % 8 == 0);
+
+              structure_geometry.geometryType = VK_GEOMETRY_TYPE_AABBS_KHR;
+              structure_geometry.geometry.aabbs.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_AABBS_DATA_KHR;
+              structure_geometry.geometry.aabbs.data.deviceAddress = vtx_address;
+              structure_geometry.geometry.aabbs.stride = vtx_stride;
+
+              range_info.primitiveCount = vtx_count;
+              range_info.primitiveOffset = vtx_offset * vtx_stride; //byte offset
+              range_info.firstVertex = 0;
+            }
+            else
+            {
+              const auto idx_resource = reinterpret_cast<VLKResource*>(&chunk.ia_views[0]->GetResource());
+              const auto idx_stride = idx_resource->GetLayersOrStride();
+              const auto idx_count = chunk.idx_or_grid_z.length;
+              const auto idx_offset = chunk.idx_or_grid_z.offset;
+              const auto idx_address = device->GetAddress(idx_resource->GetBuffer());
+
+              structure_geometry.geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR;
+              structure_geometry.geometry.triangles.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR;
+              structure_geometry.geometry.triangles.vertexData.deviceAddress = vtx_address;
+              structure_geometry.geometry.triangles.vertexStride = vtx_stride;
+              structure_geometry.geometry.triangles.vertexFormat = VK_FORMAT_R32G32B32_SFLOAT;
+              structure_geometry.geometry.triangles.maxVertex = vtx_count - 1;
+              structure_geometry.geometry.triangles.indexData.deviceAddress = idx_address;
+              structure_geometry.geometry.triangles.indexType = VK_INDEX_TYPE_UINT32;
+
+              range_info.primitiveCount = idx_count / 3;
+              range_info.primitiveOffset = idx_offset * idx_stride / 3; //byte offset
+              range_info.firstVertex = vtx_offset;
+            }
+            blas_counts[i] = range_info.primitiveCount;
+          }
+
+          auto& geometry_info = blas_infos[g];
+          geometry_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+          geometry_info.type = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR;
+          geometry_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+          geometry_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+          geometry_info.geometryCount = group.second;
+          geometry_info.pGeometries = &blas_geometries[group.first];
+
+          VkAccelerationStructureBuildSizesInfoKHR sizes_info{};
+          sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+          vkGetAccelerationStructureBuildSizesKHR(device->GetDevice(),
+            VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+            &geometry_info,
+            &blas_counts[group.first],
+            &sizes_info);
+
+          create_fn(sizes_info.accelerationStructureSize, blas_memory, blas_buffer, blas_item);
+
+          geometry_info.dstAccelerationStructure = blas_item;
+          blas_scratches[g] = sizes_info.buildScratchSize;
+          blas_builds.push_back(g);
+
+          if (!cache_item.path.empty())
+          {
+            downloads.push_back(std::move(cache_item));
+          }
+        }
+      }
+    }
+
+    std::vector<VkAccelerationStructureInstanceKHR> instances(blas_groups.size());
+    VkAccelerationStructureGeometryKHR tlas_geometry{};
+    VkAccelerationStructureBuildRangeInfoKHR tlas_range{};
+    VkAccelerationStructureBuildGeometryInfoKHR tlas_info{};
+    VkDeviceSize tlas_scratch{ 0 };
+
+    {
+      for (auto g = 0u; g < uint32_t(blas_groups.size()); ++g)
+      {
+        VkAccelerationStructureDeviceAddressInfoKHR address_info{};
+        address_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR;
+        address_info.accelerationStructure = blas_items[g];
+        const auto blas_address = vkGetAccelerationStructureDeviceAddressKHR(device->GetDevice(), &address_info);
+
+        VkTransformMatrixKHR transformMatrix = {
+          1.0f, 0.0f, 0.0f, 0.0f,
+          0.0f, 1.0f, 0.0f, 0.0f,
+          0.0f, 0.0f, 1.0f, 0.0f
+        };
+
+        // Custom index and record offset hold the first entity of the group, so entity is gl_InstanceCustomIndexEXT + gl_GeometryIndexEXT
+        // and its hit record is reached with sbtRecordStride of 1
+        instances[g] = { transformMatrix, blas_groups[g].first, 0xFF, blas_groups[g].first, VK_GEOMETRY_INSTANCE_TRIANGLE_FACING_CULL_DISABLE_BIT_KHR, blas_address };
+      }
+
+      {
+        const auto size = instances.size() * sizeof(VkAccelerationStructureInstanceKHR);
+        const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR;
+        const auto buffer = device->CreateBuffer(size, usage);
+        const auto requirements = device->GetRequirements(buffer);
+        const auto flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
+        const auto memory = device->AllocateMemory(requirements.size, index, true, VLKDevice::CATEGORY_STRUCTURE, name);
+
+        BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+        instances_buffer = buffer;
+        instances_memory = memory;
+      }
+
+      {
+        void* mapped{ nullptr };
+        BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), instances_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+        memcpy(mapped, instances.data(), instances.size() * sizeof(VkAccelerationStructureInstanceKHR));
+        vkUnmapMemory(device->GetDevice(), instances_memory);
+      }
+
+      tlas_geometry.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR;
+      tlas_geometry.geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR;
+      tlas_geometry.geometry.instances.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR;
+      tlas_geometry.geometry.instances.data.deviceAddress = device->GetAddress(instances_buffer);
+
+      tlas_range.primitiveCount = uint32_t(instances.size());
+      tlas_range.primitiveOffset = 0;
+      tlas_range.firstVertex = 0;
+      tlas_range.transformOffset = 0;
+
+      tlas_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR;
+      tlas_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+      tlas_info.flags = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR;
+      tlas_info.mode = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR;
+      tlas_info.geometryCount = 1;
+      tlas_info.pGeometries = &tlas_geometry;
+
+      VkAccelerationStructureBuildSizesInfoKHR sizes_info{};
+      sizes_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR;
+      vkGetAccelerationStructureBuildSizesKHR(device->GetDevice(),
+        VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+        &tlas_info,
+        &tlas_range.primitiveCount,
+        &sizes_info);
+
+      {
+        const auto size = sizes_info.accelerationStructureSize;
+        const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR;
+        const auto buffer = device->CreateBuffer(size, usage);
+        const auto requirements = device->GetRequirements(buffer);
+        const auto flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
+        const auto memory = device->AllocateMemory(requirements.size, index, true, VLKDevice::CATEGORY_STRUCTURE, name);
+
+        BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+        tlas_buffer = buffer;
+        tlas_memory = memory;
+      }
+
+      VkAccelerationStructureCreateInfoKHR create_info = {};
+      create_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR;
+      create_info.type = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR;
+      create_info.size = sizes_info.accelerationStructureSize;
+      create_info.buffer = tlas_buffer;
+      BLAST_ASSERT(VK_SUCCESS == vkCreateAccelerationStructureKHR(device->GetDevice(), &create_info, nullptr, &tlas_item));
+
+      tlas_info.dstAccelerationStructure = tlas_item;
+      tlas_scratch = sizes_info.buildScratchSize;
+    }
+
+    {
+      // Builds are packed into waves sharing the scratch arena at aligned offsets, each wave
+      // is issued as one concurrent build and separated from the next one by a barrier
+      const auto scratch_align = device->GetScratchAlignment();
+      const auto align_fn = [scratch_align](VkDeviceSize size) { return (size + scratch_align - 1) / scratch_align * scratch_align; };
+
+      auto scratch_peak = align_fn(tlas_scratch);
+      for (const auto i : blas_builds)
+      {
+        scratch_peak = std::max(scratch_peak, align_fn(blas_scratches[i]));
+      }
+      const auto scratch_limit = std::max(scratch_peak, device->GetScratchLimit());
+
+      std::vector<std::pair<uint32_t, VkDeviceSize>> waves; // first build, scratch offset
+      std::vector<VkDeviceSize> scratch_offsets(blas_builds.size(), 0);
+      {
+        auto scratch_offset = VkDeviceSize(0);
+        for (uint32_t j = 0; j < uint32_t(blas_builds.size()); ++j)
+        {
+          const auto scratch_size = align_fn(blas_scratches[blas_builds[j]]);
+          if (waves.empty() || scratch_offset + scratch_size > scratch_limit)
+          {
+            waves.push_back({ j, 0 });
+            scratch_offset = 0;
+          }
+          scratch_offsets[j] = scratch_offset;
+          scratch_offset += scratch_size;
+          scratch_peak = std::max(scratch_peak, scratch_offset);
+        }
+      }
+
+      device->ReserveScratch(scratch_peak);
+
+      VkMemoryBarrier memory_barrier = {};
+      memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+      memory_barrier.srcAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+      memory_barrier.dstAccessMask = VK_ACCESS_ACCELERATION_STRUCTURE_WRITE_BIT_KHR | VK_ACCESS_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+
+      if (!uploads.empty())
+      {
+        vkCmdPipelineBarrier(command_buffer,
+          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+          0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+      }
+
+      for (uint32_t k = 0; k < uint32_t(waves.size()); ++k)
+      {
+        const auto wave_begin = waves[k].first;
+        const auto wave_end = k + 1 < uint32_t(waves.size()) ? waves[k + 1].first : uint32_t(blas_builds.size());
+
+        std::vector<VkAccelerationStructureBuildGeometryInfoKHR> infos;
+        std::vector<const VkAccelerationStructureBuildRangeInfoKHR*> ranges;
+        for (uint32_t j = wave_begin; j < wave_end; ++j)
+        {
+          const auto i = blas_builds[j];
+          blas_infos[i].scratchData.deviceAddress = device->GetScratchAddress() + scratch_offsets[j];
+          infos.push_back(blas_infos[i]);
+          ranges.push_back(&blas_ranges[blas_groups[i].first]);
+        }
+        vkCmdBuildAccelerationStructuresKHR(command_buffer, uint32_t(infos.size()), infos.data(), ranges.data());
+
+        vkCmdPipelineBarrier(command_buffer,
+          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+          VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+          0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+      }
+
+      BLAST_LOG("Building %d acceleration structures for %d entities in %d waves, scratch %llu bytes [%s]",
+        uint32_t(blas_builds.size()), uint32_t(entities.size()), uint32_t(waves.size()), static_cast<unsigned long long>(scratch_peak), name.c_str());
+
+      tlas_info.scratchData.deviceAddress = device->GetScratchAddress();
+
+      const VkAccelerationStructureBuildRangeInfoKHR* range_info_ptr = &tlas_range;
+      vkCmdBuildAccelerationStructuresKHR(command_buffer, 1, &tlas_info, &range_info_ptr);
+
+      vkCmdPipelineBarrier(command_buffer,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+    }
+
+    VkQueryPool query_pool{ nullptr };
+    if (!downloads.empty())
+    {
+      VkQueryPoolCreateInfo create_info{};
+      create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+      create_info.queryType = VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR;
+      create_info.queryCount = uint32_t(downloads.size());
+      BLAST_ASSERT(VK_SUCCESS == vkCreateQueryPool(device->GetDevice(), &create_info, nullptr, &query_pool));
+
+      std::vector<VkAccelerationStructureKHR> items(downloads.size());
+      for (uint32_t i = 0; i < uint32_t(downloads.size()); ++i)
+      {
+        items[i] = blas_items[downloads[i].group];
+      }
+
+      vkCmdResetQueryPool(command_buffer, query_pool, 0, uint32_t(items.size()));
+      vkCmdWriteAccelerationStructuresPropertiesKHR(command_buffer, uint32_t(items.size()), items.data(),
+        VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, query_pool, 0);
+    }
+
+    BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
+
+    device->Wait(device->Submit(device->GetQueue(), command_buffer));
+
+    for (const auto& upload : uploads)
+    {
+      vkDestroyBuffer(device->GetDevice(), upload.first, nullptr);
+      device->FreeMemory(upload.second);
+    }
+    uploads.clear();
+
+    if (query_pool)
+    {
+      SaveCache(query_pool, downloads);
+      vkDestroyQueryPool(device->GetDevice(), query_pool, nullptr);
+    }
+  }
+
+  std::string VLKBatch::GetCachePath(uint32_t first, uint32_t count, std::vector<uint64_t>& key)
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    if (device->GetCache().empty()) return std::string();
+
+    const auto hash_fn = [](uint64_t hash, const void* data, size_t size)
+    {
+      const auto bytes = reinterpret_cast<const uint8_t*>(data);
+      for (size_t i = 0; i < size; ++i)
+      {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+      }
+      return hash;
+    };
+
+    // Geometry is hashed from the interop data the resource was created with,
+    // resources filled on GPU can not be keyed and are always rebuilt
+    const auto range_fn = [&hash_fn](uint64_t& hash, Resource& resource, size_t offset, size_t size)
+    {
+      for (uint32_t i = 0; i < resource.GetInteropCount() && size > 0; ++i)
+      {
+        const auto interop = resource.GetInteropItem(i);
+        if (interop.first == nullptr) return false;
+        if (offset >= interop.second) { offset -= interop.second; continue; }
+
+        const auto chunk = std::min(size, size_t(interop.second) - offset);
+        hash = hash_fn(hash, reinterpret_cast<const uint8_t*>(interop.first) + offset, chunk);
+        offset = 0;
+        size -= chunk;
+      }
+      return size == 0;
+    };
+
+    const uint32_t version = 4;
+
+    auto hash = 0xcbf29ce484222325ull;
+    hash = hash_fn(hash, device->GetIdentity().deviceUUID, VK_UUID_SIZE);
+    hash = hash_fn(hash, &version, sizeof(version));
+    hash = hash_fn(hash, &count, sizeof(count));
+
+    key.assign({ 0ull, count });
+
+    for (auto i = first; i < first + count; ++i)
+    {
+      const auto& entity = entities[i];
+
+      auto& vtx_resource = entity.va_views[0]->GetResource();
+      const auto vtx_stride = vtx_resource.GetLayersOrStride();
+      const auto idx_stride = entity.ia_views.empty() ? 0u : entity.ia_views[0]->GetResource().GetLayersOrStride();
+      const auto idx_count = entity.ia_views.empty() ? 0u : entity.idx_or_grid_z.length;
+
+      const uint64_t params[] = { vtx_stride, entity.vtx_or_grid_y.length, idx_stride, idx_count };
+      hash = hash_fn(hash, params, sizeof(params));
+      key.insert(key.end(), std::begin(params), std::end(params));
+      if (!range_fn(hash, vtx_resource, size_t(entity.vtx_or_grid_y.offset) * vtx_stride, size_t(entity.vtx_or_grid_y.length) * vtx_stride)) return std::string();
+      if (entity.ia_views.empty()) continue;
+
+      auto& idx_resource = entity.ia_views[0]->GetResource();
+      if (!range_fn(hash, idx_resource, size_t(entity.idx_or_grid_z.offset) * idx_stride / 3, size_t(entity.idx_or_grid_z.length) * idx_stride / 3)) return std::string();
+    }
+
+    key[0] = hash;
+
+    char file[32] = {};
+    snprintf(file, sizeof(file), "%016llx.blas", static_cast<unsigned long long>(hash));
+    return device->GetCache() + "/" + file;
+  }
+
+  bool VLKBatch::LoadCache(const std::string& path, const std::vector<uint64_t>& key, std::vector<uint8_t>& data)
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    std::ifstream fs(path, std::ios::binary | std::ios::ate);
+    if (!fs.is_open()) return false;
+
+    data.resize(size_t(fs.tellg()));
+    fs.seekg(0, std::ios::beg);
+    fs.read(reinterpret_cast<char*>(data.data()), data.size());
+
+    // Key record ahead of the blob guards against hash collisions: word count, then the key itself
+    const auto key_size = (key.size() + 1) * sizeof(uint64_t);
+    if (!fs || data.size() < key_size) return false;
+
+    const auto words = reinterpret_cast<const uint64_t*>(data.data());
+    if (words[0] != key.size() || !std::equal(key.begin(), key.end(), words + 1))
+    {
+      BLAST_LOG("Acceleration structure cache key does not match, rebuilding [%s]", path.c_str());
+      return false;
+    }
+    data.erase(data.begin(), data.begin() + key_size);
+
+    // Serialized header: driver UUID, compatibility UUID, serialized size, deserialized size, handle count
+    const auto header_size = 2 * VK_UUID_SIZE + 3 * sizeof(uint64_t);
+    if (data.size() < header_size) return false;
+
+    const auto serialized_size = reinterpret_cast<const uint64_t*>(data.data() + 2 * VK_UUID_SIZE)[0];
+    if (serialized_size != data.size()) return false;
+
+    VkAccelerationStructureVersionInfoKHR version_info{};
+    version_info.sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR;
+    version_info.pVersionData = data.data();
+
+    auto compatibility = VK_ACCELERATION_STRUCTURE_COMPATIBILITY_INCOMPATIBLE_KHR;
+    vkGetDeviceAccelerationStructureCompatibilityKHR(device->GetDevice(), &version_info, &compatibility);
+    if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR)
+    {
+      BLAST_LOG("Acceleration structure cache is incompatible, rebuilding [%s]", path.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  void VLKBatch::StoreCache(const CacheItem& item, const void* data, size_t size)
+  {
+    std::ofstream fs(item.path, std::ios::binary | std::ios::trunc);
+    if (!fs.is_open()) return;
+
+    const auto words = uint64_t(item.key.size());
+    fs.write(reinterpret_cast<const char*>(&words), sizeof(words));
+    fs.write(reinterpret_cast<const char*>(item.key.data()), std::streamsize(item.key.size() * sizeof(uint64_t)));
+    fs.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+    BLAST_LOG("Saving acceleration structure %d to cache [%s]", item.group, item.path.c_str());
+  }
+
+  void VLKBatch::SaveCache(VkQueryPool query_pool, const std::vector<CacheItem>& downloads)
+  {
+    auto config = reinterpret_cast<VLKConfig*>(&this->GetConfig());
+    auto pass = reinterpret_cast<VLKPass*>(&config->GetPass());
+    auto device = reinterpret_cast<VLKDevice*>(&pass->GetDevice());
+
+    std::vector<uint64_t> sizes(downloads.size());
+    BLAST_ASSERT(VK_SUCCESS == vkGetQueryPoolResults(device->GetDevice(), query_pool, 0, uint32_t(sizes.size()),
+      sizes.size() * sizeof(uint64_t), sizes.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    VkCommandBufferBeginInfo begin_info = {};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    std::vector<std::pair<VkBuffer, VkDeviceMemory>> targets(downloads.size());
+    for (uint32_t i = 0; i < uint32_t(downloads.size()); ++i)
+    {
+      const auto size = VkDeviceSize(sizes[i]);
+      const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+      const auto buffer = device->CreateBuffer(size, usage);
+      const auto requirements = device->GetRequirements(buffer);
+      const auto index = device->GetMemoryIndex(VLKDevice::MEMORY_READBACK, requirements.memoryTypeBits, requirements.size);
+      const auto memory = device->AllocateMemory(requirements.size, index, true, VLKDevice::CATEGORY_STAGING, name);
+
+      BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+      targets[i] = { buffer, memory };
+
+      VkCopyAccelerationStructureToMemoryInfoKHR copy_info{};
+      copy_info.sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR;
+      copy_info.src = blas_items[downloads[i].group];
+      copy_info.dst.deviceAddress = device->GetAddress(buffer);
+      copy_info.mode = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR;
+      vkCmdCopyAccelerationStructureToMemoryKHR(command_buffer, &copy_info);
+    }
+
+    VkMemoryBarrier memory_barrier = {};
+    memory_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    memory_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    memory_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer,
+      VK_PIPELINE_STAGE_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+      VK_PIPELINE_STAGE_HOST_BIT,
+      0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+
+    BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
+
+    device->Wait(device->Submit(device->GetQueue(), command_buffer));
+
+    for (uint32_t i = 0; i < uint32_t(downloads.size()); ++i)
+    {
+      void* mapped{ nullptr };
+      BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), targets[i].second, 0, VK_WHOLE_SIZE, 0, &mapped));
+      device->InvalidateMemory(targets[i].second);
+
+      StoreCache(downloads[i], mapped, size_t(sizes[i]));
+      vkUnmapMemory(device->GetDevice(), targets[i].second);
+
+      vkDestroyBuffer(device->GetDevice(), targets[i].first, nullptr);
+      device->FreeMemory(targets[i].second);
     }
   }
 
@@ -1053,12 +1847,7 @@ namespace RayGene3D
 
     if (table_memory)
     {
-      vkFreeMemory(device->GetDevice(), table_memory, nullptr); table_memory = nullptr;
-    }
-
-    if (fence)
-    {
-      vkDestroyFence(device->GetDevice(), fence, nullptr); fence = nullptr;
+      device->FreeMemory(table_memory); table_memory = nullptr;
     }
 
     if (command_buffer)
@@ -1088,11 +1877,13 @@ namespace RayGene3D
     {
       if (blas_memory)
       {
-        vkFreeMemory(device->GetDevice(), blas_memory, nullptr); blas_memory = nullptr;
+        device->FreeMemory(blas_memory); blas_memory = nullptr;
       }
     }
     blas_memories.clear();
 
+    blas_groups.clear();
+
     if (tlas_item)
     {
       vkDestroyAccelerationStructureKHR(device->GetDevice(), tlas_item, nullptr); tlas_item = nullptr;
@@ -1105,7 +1896,7 @@ namespace RayGene3D
 
     if (tlas_memory)
     {
-      vkFreeMemory(device->GetDevice(), tlas_memory, nullptr); tlas_memory = nullptr;
+      device->FreeMemory(tlas_memory); tlas_memory = nullptr;
     }
 
     if (instances_buffer)
@@ -1115,7 +1906,7 @@ namespace RayGene3D
 
     if (instances_memory)
     {
-      vkFreeMemory(device->GetDevice(), instances_memory, nullptr); instances_memory = nullptr;
+      device->FreeMemory(instances_memory); instances_memory = nullptr;
     }
 
     for (auto& sampler_state : sampler_states)
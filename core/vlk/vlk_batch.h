@@ -86,6 +86,7 @@ namespace RayGene3D
     std::vector<VkDeviceMemory> blas_memories;
     std::vector<VkBuffer> blas_buffers;
     std::vector<VkAccelerationStructureKHR> blas_items;
+    std::vector<std::pair<uint32_t, uint32_t>> blas_groups; // first entity, entity count
 
     VkDeviceMemory tlas_memory{ nullptr };
     VkBuffer tlas_buffer{ nullptr };
@@ -95,7 +96,6 @@ namespace RayGene3D
     VkBuffer instances_buffer{ nullptr };
 
     VkCommandBuffer command_buffer{ nullptr };
-    VkFence fence{ nullptr };
 
   protected:
     PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelinesKHR{ nullptr };
@@ -114,6 +114,38 @@ namespace RayGene3D
     PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizesKHR{ nullptr };
     PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructuresKHR{ nullptr };
     PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructureKHR{ nullptr };
+    PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresPropertiesKHR{ nullptr };
+    PFN_vkCmdCopyAccelerationStructureToMemoryKHR vkCmdCopyAccelerationStructureToMemoryKHR{ nullptr };
+    PFN_vkCmdCopyMemoryToAccelerationStructureKHR vkCmdCopyMemoryToAccelerationStructureKHR{ nullptr };
+    PFN_vkGetDeviceAccelerationStructureCompatibilityKHR vkGetDeviceAccelerationStructureCompatibilityKHR{ nullptr };
+    PFN_vkBuildAccelerationStructuresKHR vkBuildAccelerationStructuresKHR{ nullptr };
+    PFN_vkCopyAccelerationStructureToMemoryKHR vkCopyAccelerationStructureToMemoryKHR{ nullptr };
+    PFN_vkCopyMemoryToAccelerationStructureKHR vkCopyMemoryToAccelerationStructureKHR{ nullptr };
+    PFN_vkWriteAccelerationStructuresPropertiesKHR vkWriteAccelerationStructuresPropertiesKHR{ nullptr };
+
+  public:
+    void UpdateSets();
+    void UpdatePipeline();
+
+  protected:
+    const void* GetHostData(Resource& resource, size_t offset, size_t size);
+    void GroupEntities();
+    bool BuildOnHost();
+    void BuildOnDevice();
+
+  protected:
+    struct CacheItem
+    {
+      uint32_t group{ 0 };
+      std::string path;
+      std::vector<uint64_t> key; // hash, entity count, then strides and sizes per entity
+    };
+
+  protected:
+    std::string GetCachePath(uint32_t first, uint32_t count, std::vector<uint64_t>& key);
+    bool LoadCache(const std::string& path, const std::vector<uint64_t>& key, std::vector<uint8_t>& data);
+    void StoreCache(const CacheItem& item, const void* data, size_t size);
+    void SaveCache(VkQueryPool query_pool, const std::vector<CacheItem>& downloads);
 
   public:
     void Initialize() override;
@@ -171,11 +171,6 @@ namespace RayGene3D
     if (compilation & COMPILATION_TASK) { CompileVLK(source, "main", "task", defines, path, task_bytecode); BLAST_ASSERT(!rgen_bytecode.empty()); }
     if (compilation & COMPILATION_MESH) { CompileVLK(source, "main", "mesh", defines, path, mesh_bytecode); BLAST_ASSERT(!mesh_bytecode.empty()); }
     if (compilation & COMPILATION_RGEN) { CompileVLK(source, "main", "rgen", defines, path, rgen_bytecode); BLAST_ASSERT(!rgen_bytecode.empty()); }
-    if (compilation & COMPILATION_ISEC) { CompileVLK(source, "main", "isec", defines, path, isec_bytecode); BLAST_ASSERT(!isec_bytecode.empty()); }
-    if (compilation & COMPILATION_MISS) { CompileVLK(source, "main", "miss", defines, path, miss_bytecode); BLAST_ASSERT(!miss_bytecode.empty()); }
-    if (compilation & COMPILATION_CHIT) { CompileVLK(source, "main", "chit", defines, path, chit_bytecode); BLAST_ASSERT(!chit_bytecode.empty()); }
-    if (compilation & COMPILATION_AHIT) { CompileVLK(source, "main", "ahit", defines, path, ahit_bytecode); BLAST_ASSERT(!ahit_bytecode.empty()); }
-    if (compilation & COMPILATION_CALL) { CompileVLK(source, "main", "call", defines, path, call_bytecode); BLAST_ASSERT(!call_bytecode.empty()); }
 
     {
       const auto create_shader_module = [device](const std::vector<char>& bytecode)
@@ -269,137 +264,103 @@ namespace RayGene3D
         stages.push_back(create_info);
       }
 
-      // RTX shaders
-      if (!rgen_bytecode.empty())
+      // RTX shaders, miss, hit and callable shaders are compiled once per variant with MISS_GROUP,
+      // HIT_GROUP or CALL_GROUP set, variant counts are taken from MISS_GROUPS, HIT_GROUPS and CALL_GROUPS
       {
-        auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
-        shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        shader_group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-        shader_group.generalShader = uint32_t(stages.size()); // rgen shader;
-        shader_group.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_group.closestHitShader = VK_SHADER_UNUSED_KHR;
-        shader_group.anyHitShader = VK_SHADER_UNUSED_KHR;
-        groups.push_back(shader_group);
-
-        rgen_module = create_shader_module(rgen_bytecode);
-
-        auto create_info = VkPipelineShaderStageCreateInfo{};
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = VK_SHADER_STAGE_RAYGEN_BIT_KHR;
-        create_info.module = rgen_module;
-        create_info.pName = "main";
-        create_info.pSpecializationInfo = nullptr;
-        stages.push_back(create_info);
-      }
-
-      if (!isec_bytecode.empty())
-      {
-        auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
-        shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        shader_group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR;
-        shader_group.generalShader = VK_SHADER_UNUSED_KHR;
-        shader_group.intersectionShader = uint32_t(stages.size());
-        shader_group.closestHitShader = VK_SHADER_UNUSED_KHR;
-        shader_group.anyHitShader = VK_SHADER_UNUSED_KHR;
-        groups.push_back(shader_group);
-
-        isec_module = create_shader_module(isec_bytecode);
-
-        auto create_info = VkPipelineShaderStageCreateInfo{};
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = VK_SHADER_STAGE_INTERSECTION_BIT_KHR;
-        create_info.module = isec_module;
-        create_info.pName = "main";
-        create_info.pSpecializationInfo = nullptr;
-        stages.push_back(create_info);
-      }
-
-      if (!miss_bytecode.empty())
-      {
-        auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
-        shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        shader_group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-        shader_group.generalShader = uint32_t(stages.size()); // miss shader;
-        shader_group.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_group.closestHitShader = VK_SHADER_UNUSED_KHR;
-        shader_group.anyHitShader = VK_SHADER_UNUSED_KHR;
-        groups.push_back(shader_group);
-
-        miss_module = create_shader_module(miss_bytecode);
-
-        auto create_info = VkPipelineShaderStageCreateInfo{};
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = VK_SHADER_STAGE_MISS_BIT_KHR;
-        create_info.module = miss_module;
-        create_info.pName = "main";
-        create_info.pSpecializationInfo = nullptr;
-        stages.push_back(create_info);
-      }
-
-      if (!chit_bytecode.empty())
-      {
-        auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
-        shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        shader_group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
-        shader_group.generalShader = VK_SHADER_UNUSED_KHR;
-        shader_group.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_group.closestHitShader = uint32_t(stages.size()); // chit shader;
-        shader_group.anyHitShader = VK_SHADER_UNUSED_KHR;
-        groups.push_back(shader_group);
-
-        chit_module = create_shader_module(chit_bytecode);
-
-        auto create_info = VkPipelineShaderStageCreateInfo{};
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR;
-        create_info.module = chit_module;
-        create_info.pName = "main";
-        create_info.pSpecializationInfo = nullptr;
-        stages.push_back(create_info);
-      }
-
-      if (!ahit_bytecode.empty())
-      {
-        auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
-        shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        shader_group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR;
-        shader_group.generalShader = VK_SHADER_UNUSED_KHR;
-        shader_group.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_group.closestHitShader = VK_SHADER_UNUSED_KHR;
-        shader_group.anyHitShader = uint32_t(stages.size()); // ahit shader;
-        groups.push_back(shader_group);
-
-        ahit_module = create_shader_module(ahit_bytecode);
-
-        auto create_info = VkPipelineShaderStageCreateInfo{};
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = VK_SHADER_STAGE_ANY_HIT_BIT_KHR;
-        create_info.module = ahit_module;
-        create_info.pName = "main";
-        create_info.pSpecializationInfo = nullptr;
-        stages.push_back(create_info);
-      }
-
-      if (!call_bytecode.empty())
-      {
-        auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
-        shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
-        shader_group.type = VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR;
-        shader_group.generalShader = uint32_t(stages.size());
-        shader_group.intersectionShader = VK_SHADER_UNUSED_KHR;
-        shader_group.closestHitShader = VK_SHADER_UNUSED_KHR;
-        shader_group.anyHitShader = VK_SHADER_UNUSED_KHR; // ahit shader;
-        groups.push_back(shader_group);
-
-        call_module = create_shader_module(call_bytecode);
-
-        auto create_info = VkPipelineShaderStageCreateInfo{};
-        create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-        create_info.stage = VK_SHADER_STAGE_CALLABLE_BIT_KHR;
-        create_info.module = call_module;
-        create_info.pName = "main";
-        create_info.pSpecializationInfo = nullptr;
-        stages.push_back(create_info);
+        const auto count_fn = [this](const char* name)
+        {
+          const auto define = defines.find(name);
+          return define == defines.end() ? 1u : std::max(1u, uint32_t(std::stoul(define->second)));
+        };
+
+        const auto compile_fn = [this, &path](uint32_t flag, const char* target, const char* variant, uint32_t index, std::vector<char>& bytecode)
+        {
+          bytecode.clear();
+          if ((compilation & flag) == 0) return;
+
+          auto variant_defines = defines;
+          variant_defines[variant] = std::to_string(index);
+          CompileVLK(source, "main", target, variant_defines, path, bytecode);
+          BLAST_ASSERT(!bytecode.empty());
+        };
+
+        const auto stage_fn = [this, &create_shader_module](const std::vector<char>& bytecode, VkShaderStageFlagBits stage)
+        {
+          if (bytecode.empty()) return uint32_t(VK_SHADER_UNUSED_KHR);
+
+          auto create_info = VkPipelineShaderStageCreateInfo{};
+          create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+          create_info.stage = stage;
+          create_info.module = tracing_modules.emplace_back(create_shader_module(bytecode));
+          create_info.pName = "main";
+          create_info.pSpecializationInfo = nullptr;
+          stages.push_back(create_info);
+
+          return uint32_t(stages.size() - 1);
+        };
+
+        const auto group_fn = [this](VkRayTracingShaderGroupTypeKHR type, uint32_t general, uint32_t isec, uint32_t chit, uint32_t ahit)
+        {
+          auto shader_group = VkRayTracingShaderGroupCreateInfoKHR{};
+          shader_group.sType = VK_STRUCTURE_TYPE_RAY_TRACING_SHADER_GROUP_CREATE_INFO_KHR;
+          shader_group.type = type;
+          shader_group.generalShader = general;
+          shader_group.intersectionShader = isec;
+          shader_group.closestHitShader = chit;
+          shader_group.anyHitShader = ahit;
+          groups.push_back(shader_group);
+        };
+
+        const auto unused = uint32_t(VK_SHADER_UNUSED_KHR);
+
+        if (!rgen_bytecode.empty())
+        {
+          group_fn(VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR, stage_fn(rgen_bytecode, VK_SHADER_STAGE_RAYGEN_BIT_KHR), unused, unused, unused);
+        }
+
+        miss_groups = { uint32_t(groups.size()), 0 };
+        for (uint32_t k = 0; (compilation & COMPILATION_MISS) && k < count_fn("MISS_GROUPS"); ++k)
+        {
+          compile_fn(COMPILATION_MISS, "miss", "MISS_GROUP", k, miss_bytecode);
+          group_fn(VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR, stage_fn(miss_bytecode, VK_SHADER_STAGE_MISS_BIT_KHR), unused, unused, unused);
+          miss_groups.second += 1;
+        }
+
+        std::vector<std::array<uint32_t, 3>> hit_stages; // isec, chit, ahit
+        for (uint32_t k = 0; (compilation & (COMPILATION_ISEC | COMPILATION_CHIT | COMPILATION_AHIT)) && k < count_fn("HIT_GROUPS"); ++k)
+        {
+          compile_fn(COMPILATION_ISEC, "isec", "HIT_GROUP", k, isec_bytecode);
+          compile_fn(COMPILATION_CHIT, "chit", "HIT_GROUP", k, chit_bytecode);
+          compile_fn(COMPILATION_AHIT, "ahit", "HIT_GROUP", k, ahit_bytecode);
+          hit_stages.push_back({
+            stage_fn(isec_bytecode, VK_SHADER_STAGE_INTERSECTION_BIT_KHR),
+            stage_fn(chit_bytecode, VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR),
+            stage_fn(ahit_bytecode, VK_SHADER_STAGE_ANY_HIT_BIT_KHR) });
+        }
+
+        xhit_groups = { uint32_t(groups.size()), 0 };
+        for (const auto& hit : hit_stages)
+        {
+          if (hit[1] == unused && hit[2] == unused) continue;
+          group_fn(VK_RAY_TRACING_SHADER_GROUP_TYPE_TRIANGLES_HIT_GROUP_KHR, unused, unused, hit[1], hit[2]);
+          xhit_groups.second += 1;
+        }
+
+        proc_groups = { uint32_t(groups.size()), 0 };
+        for (const auto& hit : hit_stages)
+        {
+          if (hit[0] == unused) continue;
+          group_fn(VK_RAY_TRACING_SHADER_GROUP_TYPE_PROCEDURAL_HIT_GROUP_KHR, unused, hit[0], hit[1], hit[2]);
+          proc_groups.second += 1;
+        }
+
+        call_groups = { uint32_t(groups.size()), 0 };
+        for (uint32_t k = 0; (compilation & COMPILATION_CALL) && k < count_fn("CALL_GROUPS"); ++k)
+        {
+          compile_fn(COMPILATION_CALL, "call", "CALL_GROUP", k, call_bytecode);
+          group_fn(VK_RAY_TRACING_SHADER_GROUP_TYPE_GENERAL_KHR, stage_fn(call_bytecode, VK_SHADER_STAGE_CALLABLE_BIT_KHR), unused, unused, unused);
+          call_groups.second += 1;
+        }
       }
 
       if (!task_bytecode.empty())
@@ -854,29 +815,12 @@ namespace RayGene3D
     }
 
     //RTX shaders
-    if (rgen_module)
-    {
-      vkDestroyShaderModule(device->GetDevice(), rgen_module, nullptr);
-      rgen_module = nullptr;
-    }
-
-    if (chit_module)
-    {
-      vkDestroyShaderModule(device->GetDevice(), chit_module, nullptr);
-      chit_module = nullptr;
-    }
-
-    if (ahit_module)
-    {
-      vkDestroyShaderModule(device->GetDevice(), ahit_module, nullptr);
-      ahit_module = nullptr;
-    }
-
-    if (miss_module)
+    for (auto& tracing_module : tracing_modules)
     {
-      vkDestroyShaderModule(device->GetDevice(), miss_module, nullptr);
-      miss_module = nullptr;
+      vkDestroyShaderModule(device->GetDevice(), tracing_module, nullptr);
     }
+    tracing_modules.clear();
+    groups.clear();
   }
 
   VLKConfig::VLKConfig(const std::string& name,
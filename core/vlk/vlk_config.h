@@ -58,16 +58,15 @@ namespace RayGene3D
     VkShaderModule mesh_module{ nullptr };
 
   protected:
-    VkShaderModule rgen_module{ nullptr };
-    VkShaderModule isec_module{ nullptr };
-    VkShaderModule chit_module{ nullptr };
-    VkShaderModule ahit_module{ nullptr };
-    VkShaderModule miss_module{ nullptr };
-    VkShaderModule call_module{ nullptr };
+    std::vector<VkShaderModule> tracing_modules;
 
   protected:
     std::vector<VkPipelineShaderStageCreateInfo> stages;
     std::vector<VkRayTracingShaderGroupCreateInfoKHR> groups;
+    std::pair<uint32_t, uint32_t> miss_groups{ 0, 0 }; // first group, group count
+    std::pair<uint32_t, uint32_t> xhit_groups{ 0, 0 };
+    std::pair<uint32_t, uint32_t> proc_groups{ 0, 0 };
+    std::pair<uint32_t, uint32_t> call_groups{ 0, 0 };
 
   protected:
     bool use_vertex_input{ false };
@@ -117,6 +116,10 @@ namespace RayGene3D
     const VkPipelineShaderStageCreateInfo* GetStageArray() const { return stages.data(); }
     uint32_t GetGroupCount() const { return uint32_t(groups.size()); }
     const VkRayTracingShaderGroupCreateInfoKHR* GetGroupArray() const { return groups.data(); }
+    const std::pair<uint32_t, uint32_t>& GetMissGroups() const { return miss_groups; }
+    const std::pair<uint32_t, uint32_t>& GetXHitGroups() const { return xhit_groups; }
+    const std::pair<uint32_t, uint32_t>& GetProcGroups() const { return proc_groups; }
+    const std::pair<uint32_t, uint32_t>& GetCallGroups() const { return call_groups; }
 
   public:
     bool UseVertexInput() const { return use_vertex_input; }
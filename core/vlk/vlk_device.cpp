@@ -29,6 +29,9 @@ THE SOFTWARE.
 
 #include "vlk_device.h"
 
+#include <thread>
+#include <numeric>
+
 namespace RayGene3D
 {
   void VLKDevice::CreateInstance()
@@ -114,10 +117,31 @@ namespace RayGene3D
       allocate_info.commandBufferCount = 1;
       BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device, &allocate_info, &present_command_buffer));
     }
+
+    pool_info.queueFamilyIndex = compute_family;
+    BLAST_ASSERT(VK_SUCCESS == vkCreateCommandPool(device, &pool_info, nullptr, &compute_pool));
+
+    pool_info.queueFamilyIndex = transfer_family;
+    BLAST_ASSERT(VK_SUCCESS == vkCreateCommandPool(device, &pool_info, nullptr, &transfer_pool));
   }
 
   void VLKDevice::DestroyPool()
   {
+    graphic_buffers.clear();
+    compute_buffers.clear();
+
+    if (device && transfer_pool)
+    {
+      vkDestroyCommandPool(device, transfer_pool, nullptr);
+      transfer_pool = nullptr;
+    }
+
+    if (device && compute_pool)
+    {
+      vkDestroyCommandPool(device, compute_pool, nullptr);
+      compute_pool = nullptr;
+    }
+
     if (device && command_pool)
     {
       vkDestroyCommandPool(device, command_pool, nullptr);
@@ -214,6 +238,14 @@ namespace RayGene3D
     vkGetPhysicalDeviceFeatures(adapter, &features);
     vkGetPhysicalDeviceMemoryProperties(adapter, &memory);
 
+    {
+      identity.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+      VkPhysicalDeviceProperties2 device_properties = {};
+      device_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+      device_properties.pNext = &identity;
+      vkGetPhysicalDeviceProperties2(adapter, &device_properties);
+    }
+
     auto queue_count = uint32_t{ 0 };
     vkGetPhysicalDeviceQueueFamilyProperties(adapter, &queue_count, nullptr);
     auto queue_array = std::vector<VkQueueFamilyProperties>(queue_count);
@@ -222,7 +254,7 @@ namespace RayGene3D
     const auto queue_flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_SPARSE_BINDING_BIT;
     for (uint32_t i = 0; i < queue_count; ++i)
     {
-      if (queue_array[i].queueFlags & queue_flags)
+      if ((queue_array[i].queueFlags & queue_flags) && (queue_array[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
       {
         family = i;
         break;
@@ -233,6 +265,28 @@ namespace RayGene3D
     }
     BLAST_ASSERT(family != -1);
 
+    // Dedicated families run async compute and uploads next to graphics, the main family stands in otherwise
+    for (uint32_t i = 0; i < queue_count; ++i)
+    {
+      const auto flags = queue_array[i].queueFlags;
+      if (compute_family == -1 && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+      {
+        compute_family = i;
+      }
+      if (transfer_family == -1 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      {
+        transfer_family = i;
+      }
+    }
+    compute_family = compute_family == -1 ? family : compute_family;
+    transfer_family = transfer_family == -1 ? family : transfer_family;
+
+    families.clear();
+    for (const auto index : { family, compute_family, transfer_family })
+    {
+      if (std::find(families.begin(), families.end(), index) == families.end()) families.push_back(index);
+    }
+
     auto extension_count = uint32_t{ 0 };
     BLAST_ASSERT(VK_SUCCESS == vkEnumerateDeviceExtensionProperties(adapter, nullptr, &extension_count, nullptr));
     auto extension_array = std::vector<VkExtensionProperties>(extension_count);
@@ -251,7 +305,9 @@ namespace RayGene3D
 
       if (ray_tracing_supported)
       {
+        acceleration_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
         ray_tracing_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
+        ray_tracing_properties.pNext = &acceleration_properties;
         VkPhysicalDeviceProperties2 device_properties = {};
         device_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
         device_properties.pNext = &ray_tracing_properties;
@@ -260,6 +316,45 @@ namespace RayGene3D
         extension_names.push_back(VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME);
         extension_names.push_back(VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME);
         extension_names.push_back(VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME);
+
+        VkPhysicalDeviceAccelerationStructureFeaturesKHR acceleration_features = {};
+        acceleration_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+        VkPhysicalDeviceFeatures2 device_features = {};
+        device_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        device_features.pNext = &acceleration_features;
+        vkGetPhysicalDeviceFeatures2(adapter, &device_features);
+
+        host_build_supported = acceleration_features.accelerationStructureHostCommands == VK_TRUE;
+      }
+    }
+
+    {
+      memory_budget_supported = extension_check_fn(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+      if (memory_budget_supported)
+      {
+        extension_names.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        UpdateBudget();
+      }
+    }
+
+    {
+      host_import_supported = extension_check_fn(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+
+      if (host_import_supported)
+      {
+        extension_names.push_back(VK_KHR_EXTERNAL_MEMORY_EXTENSION_NAME);
+        extension_names.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+
+        auto host_properties = VkPhysicalDeviceExternalMemoryHostPropertiesEXT{};
+        host_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+        auto device_properties = VkPhysicalDeviceProperties2{};
+        device_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        device_properties.pNext = &host_properties;
+        vkGetPhysicalDeviceProperties2(adapter, &device_properties);
+
+        host_import_alignment = host_properties.minImportedHostPointerAlignment;
       }
     }
 
@@ -282,6 +377,7 @@ namespace RayGene3D
     as_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
     as_features.pNext = nullptr;
     as_features.accelerationStructure = true;
+    as_features.accelerationStructureHostCommands = host_build_supported;
 
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR rtp_features = {};
     rtp_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
@@ -304,6 +400,16 @@ namespace RayGene3D
       ray_tracing_supported ? (void*) & bda_features: 
       nullptr;
 
+    VkPhysicalDeviceTimelineSemaphoreFeatures ts_features = {};
+    ts_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    ts_features.pNext = extention_features;
+    ts_features.timelineSemaphore = true;
+
+    // Sparse resources are bound on the main queue, without it or with sparse turned off they get regular memory
+    sparse_supported = sparse && features.sparseBinding && features.sparseResidencyBuffer && features.sparseResidencyImage2D
+      && (queue_array[family].queueFlags & VK_QUEUE_SPARSE_BINDING_BIT);
+    sparse_3d_supported = sparse_supported && features.sparseResidencyImage3D;
+
     VkPhysicalDeviceFeatures enabled_features{};
     BLAST_ASSERT(features.samplerAnisotropy);          enabled_features.samplerAnisotropy = true;
     BLAST_ASSERT(features.robustBufferAccess);         enabled_features.robustBufferAccess = true;
@@ -311,19 +417,27 @@ namespace RayGene3D
     BLAST_ASSERT(features.tessellationShader);         enabled_features.tessellationShader = true;
     BLAST_ASSERT(features.imageCubeArray);             enabled_features.imageCubeArray = true;
     BLAST_ASSERT(features.multiViewport);              enabled_features.multiViewport = true;
+    enabled_features.sparseBinding = sparse_supported;
+    enabled_features.sparseResidencyBuffer = sparse_supported;
+    enabled_features.sparseResidencyImage2D = sparse_supported;
+    enabled_features.sparseResidencyImage3D = sparse_3d_supported;
 
-    VkDeviceQueueCreateInfo queue_create_info = {};
-    queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queue_create_info.queueFamilyIndex = family;
-    queue_create_info.queueCount = 1;
     const float priority = 1.0f; // 0.0...1.0
-    queue_create_info.pQueuePriorities = &priority;
+    std::vector<VkDeviceQueueCreateInfo> queue_create_infos(families.size());
+    for (size_t i = 0; i < families.size(); ++i)
+    {
+      auto& queue_create_info = queue_create_infos[i];
+      queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+      queue_create_info.queueFamilyIndex = families[i];
+      queue_create_info.queueCount = 1;
+      queue_create_info.pQueuePriorities = &priority;
+    }
 
     VkDeviceCreateInfo device_create_info = {};
     device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    device_create_info.pNext = extention_features;
-    device_create_info.pQueueCreateInfos = &queue_create_info;
-    device_create_info.queueCreateInfoCount = 1;
+    device_create_info.pNext = &ts_features;
+    device_create_info.pQueueCreateInfos = queue_create_infos.data();
+    device_create_info.queueCreateInfoCount = uint32_t(queue_create_infos.size());
     device_create_info.enabledLayerCount = 0;
     device_create_info.ppEnabledLayerNames = nullptr;
     device_create_info.enabledExtensionCount = uint32_t(extension_names.size());
@@ -332,11 +446,28 @@ namespace RayGene3D
     BLAST_ASSERT(VK_SUCCESS == vkCreateDevice(adapter, &device_create_info, nullptr, &device));
 
     vkGetDeviceQueue(device, family, 0, &queue);
+    vkGetDeviceQueue(device, compute_family, 0, &compute_queue);
+    vkGetDeviceQueue(device, transfer_family, 0, &transfer_queue);
+
+    if (ray_tracing_supported)
+    {
+      vkCreateDeferredOperationKHR = reinterpret_cast<PFN_vkCreateDeferredOperationKHR>(vkGetDeviceProcAddr(device, "vkCreateDeferredOperationKHR"));
+      vkDestroyDeferredOperationKHR = reinterpret_cast<PFN_vkDestroyDeferredOperationKHR>(vkGetDeviceProcAddr(device, "vkDestroyDeferredOperationKHR"));
+      vkGetDeferredOperationMaxConcurrencyKHR = reinterpret_cast<PFN_vkGetDeferredOperationMaxConcurrencyKHR>(vkGetDeviceProcAddr(device, "vkGetDeferredOperationMaxConcurrencyKHR"));
+      vkGetDeferredOperationResultKHR = reinterpret_cast<PFN_vkGetDeferredOperationResultKHR>(vkGetDeviceProcAddr(device, "vkGetDeferredOperationResultKHR"));
+      vkDeferredOperationJoinKHR = reinterpret_cast<PFN_vkDeferredOperationJoinKHR>(vkGetDeviceProcAddr(device, "vkDeferredOperationJoinKHR"));
+    }
 
-    BLAST_LOG("Device is created on %s [RT:%s, MS:%s]",
+    if (host_import_supported)
+    {
+      vkGetMemoryHostPointerPropertiesEXT = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT"));
+    }
+
+    BLAST_LOG("Device is created on %s [RT:%s, MS:%s, Queues:%d/%d/%d]",
       properties.deviceName,
       ray_tracing_supported ? "On" : "Off",
-      mesh_shader_supported ? "On" : "Off");
+      mesh_shader_supported ? "On" : "Off",
+      family, compute_family, transfer_family);
 
     name = std::string(properties.deviceName) + " (Vulkan API)";
   }
@@ -427,50 +558,128 @@ namespace RayGene3D
     CreateFence();
     CreateStaging();
     CreateScratch();
+    CreateRing();
   }
 
   void VLKDevice::Use()
   {
-    auto src_image = reinterpret_cast<VLKResource*>(screen.get())->GetImage();
+    auto src_resource = reinterpret_cast<VLKResource*>(screen.get());
+    auto src_image = src_resource->GetImage();
+
+    if (Schedule())
+    {
+      Compile();
+    }
+
+    UpdateResidency();
+
+    // Async compute passes are split into segments of their own, submitted to the compute queue
+    struct Segment
+    {
+      bool async{ false };
+      std::vector<std::shared_ptr<Pass>> passes;
+      std::map<const Resource*, bool> uses; // written or not
+      uint64_t point{ 0 };
+    };
+    std::vector<Segment> segments;
+    for (const auto& pass : schedule)
+    {
+      const auto async = pass->GetAsync() && pass->GetType() == Pass::TYPE_COMPUTE && compute_queue != queue;
+      if (segments.empty() || segments.back().async != async)
+      {
+        segments.emplace_back().async = async;
+      }
+
+      auto& segment = segments.back();
+      segment.passes.push_back(pass);
+      pass->VisitView([&segment](const std::shared_ptr<View>& view, bool write)
+      {
+        const auto resource = reinterpret_cast<VLKResource*>(&view->GetResource());
+        segment.uses[resource] |= write;
+        for (const auto alias : resource->GetAliases()) segment.uses[alias] |= true;
+        return false;
+      });
+    }
+
+    // A segment waits for the timeline of the other queue up to the last segment it conflicts with
+    const auto conflict_fn = [](const Segment& lhs, const Segment& rhs)
+    {
+      for (const auto& [resource, write] : lhs.uses)
+      {
+        const auto it = rhs.uses.find(resource);
+        if (it == rhs.uses.end()) continue;
+        if (write || it->second || resource->GetType() != Resource::TYPE_BUFFER) return true;
+      }
+      return false;
+    };
+
+    const auto buffer_fn = [this](VkCommandPool pool, std::vector<VkCommandBuffer>& buffers, uint32_t index)
+    {
+      while (buffers.size() <= index)
+      {
+        VkCommandBufferAllocateInfo allocate_info = {};
+        allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocate_info.commandPool = pool;
+        allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocate_info.commandBufferCount = 1;
+        BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device, &allocate_info, &buffers.emplace_back()));
+      }
+      return buffers[index];
+    };
+
     {
+      uint32_t graphic_count = 0;
+      uint32_t compute_count = 0;
+      const auto graphic_buffer = command_buffer;
 
+      for (uint32_t i = 0; i < uint32_t(segments.size()); ++i)
       {
+        auto& segment = segments[i];
+
+        command_buffer = segment.async ? buffer_fn(compute_pool, compute_buffers, compute_count++)
+          : graphic_count++ == 0 ? graphic_buffer : buffer_fn(command_pool, graphic_buffers, graphic_count - 2);
+
         auto begin_info = VkCommandBufferBeginInfo{};
         begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         begin_info.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
         begin_info.pInheritanceInfo = nullptr;
         BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &begin_info));
 
-        for (auto& pass : passes)
+        for (auto& pass : segment.passes)
         {
           pass->Use();
         }
 
         BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
-      }
 
-      {
-        BLAST_ASSERT(VK_SUCCESS == vkResetFences(device, 1, &fence));
+        auto after = uint64_t(0);
+        for (uint32_t j = 0; j < i; ++j)
+        {
+          if (segments[j].async != segment.async && conflict_fn(segments[j], segment)) after = std::max(after, segments[j].point);
+        }
+        segment.point = Submit(segment.async ? compute_queue : queue, command_buffer, after);
+      }
 
-        std::vector<VkSemaphore> waits;
-        std::vector<VkPipelineStageFlags> stages;
-        std::vector<VkSemaphore> signals;
+      command_buffer = graphic_buffer;
+    }
 
-        VkSubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.waitSemaphoreCount = uint32_t(waits.size());
-        submit_info.pWaitSemaphores = waits.data();
-        submit_info.pWaitDstStageMask = stages.data();
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer;
-        submit_info.signalSemaphoreCount = uint32_t(signals.size());
-        submit_info.pSignalSemaphores = signals.data();
-        BLAST_ASSERT(VK_SUCCESS == vkQueueSubmit(queue, 1, &submit_info, fence));
+    UpdateBudget();
+    if (!snapshot_path.empty() && snapshot_period > 0 && frame % snapshot_period == 0)
+    {
+      Snapshot(snapshot_path);
+    }
+    ++frame;
 
-        BLAST_ASSERT(VK_SUCCESS == vkWaitForFences(device, 1, &fence, true, UINT64_MAX));
-      }
+    if (ring_frame > 0)
+    {
+      const auto bytes = ring_frame;
+      OnComplete(point, [this, bytes]() { ring_fill -= bytes; });
+      ring_frame = 0;
     }
 
+    // Frames are not overlapped yet, everything is finished before the copy to the swapchain
+    Wait(point);
+
 
     {
       uint32_t image_index = 0;
@@ -503,21 +712,29 @@ namespace RayGene3D
       }
 
       {
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = src_image;
-        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-        vkCmdPipelineBarrier(present_command_buffer,
-          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
-          0, nullptr,
-          0, nullptr,
-          1, &barrier);
+        VkPipelineStageFlags src_stages{ 0 };
+        VkAccessFlags src_accesses{ 0 };
+        VkPipelineStageFlags dst_stages{ 0 };
+        VkAccessFlags dst_accesses{ 0 };
+
+        std::vector<VkImageMemoryBarrier> barriers;
+        src_resource->Transition({ 0, 1 }, { 0, 1 }, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, false,
+          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, src_stages, dst_stages, barriers);
+        src_resource->Track(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, false,
+          src_stages, src_accesses, dst_stages, dst_accesses);
+
+        if (src_stages != 0)
+        {
+          VkMemoryBarrier barrier = {};
+          barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+          barrier.srcAccessMask = src_accesses;
+          barrier.dstAccessMask = dst_accesses;
+          vkCmdPipelineBarrier(present_command_buffer,
+            src_stages, dst_stages, 0,
+            1, &barrier,
+            0, nullptr,
+            uint32_t(barriers.size()), barriers.data());
+        }
       }
 
       VkImageCopy copy = {};
@@ -549,40 +766,11 @@ namespace RayGene3D
           1, &barrier);
       }
 
-      {
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = 0;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = src_image;
-        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-        vkCmdPipelineBarrier(present_command_buffer,
-          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
-          0, nullptr,
-          0, nullptr,
-          1, &barrier);
-      }
-
       BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(present_command_buffer));
 
 
-      VkSubmitInfo submitInfo = {};
-      submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-      VkSemaphore waitSemaphores[] = { imageAvailableSemaphore };
-      VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT };
-      submitInfo.waitSemaphoreCount = 1;
-      submitInfo.pWaitSemaphores = waitSemaphores;
-      submitInfo.pWaitDstStageMask = waitStages;
-      submitInfo.commandBufferCount = 1;
-      submitInfo.pCommandBuffers = &present_command_buffer;
+      Submit(queue, present_command_buffer, 0, imageAvailableSemaphore, renderFinishedSemaphore);
       VkSemaphore signalSemaphores[] = { renderFinishedSemaphore };
-      submitInfo.signalSemaphoreCount = 1;
-      submitInfo.pSignalSemaphores = signalSemaphores;
-      BLAST_ASSERT(VK_SUCCESS == vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
 
       VkPresentInfoKHR presentInfo = {};
       presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -604,10 +792,24 @@ namespace RayGene3D
     BLAST_ASSERT(VK_SUCCESS == vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore));
     BLAST_ASSERT(VK_SUCCESS == vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore));
 
-    VkFenceCreateInfo create_info = {};
-    create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    BLAST_ASSERT(VK_SUCCESS == vkCreateFence(device, &create_info, nullptr, &fence));
+    // Timeline values are shared by all queues, so waiting for a point covers every queue up to it
+    for (const auto item : { queue, compute_queue, transfer_queue })
+    {
+      if (std::any_of(timelines.begin(), timelines.end(), [item](const Timeline& timeline) { return timeline.queue == item; })) continue;
+
+      VkSemaphoreTypeCreateInfo type_info = {};
+      type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+      type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+      type_info.initialValue = point;
+
+      VkSemaphoreCreateInfo create_info = {};
+      create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+      create_info.pNext = &type_info;
+
+      auto& timeline = timelines.emplace_back();
+      timeline.queue = item;
+      BLAST_ASSERT(VK_SUCCESS == vkCreateSemaphore(device, &create_info, nullptr, &timeline.semaphore));
+    }
   }
 
 
@@ -625,10 +827,133 @@ namespace RayGene3D
       renderFinishedSemaphore = nullptr;
     }
 
-    if (fence)
+    // Whatever waits for completion is released once the device is idle
+    Collect();
+    callbacks.clear();
+
+    for (auto& timeline : timelines)
+    {
+      vkDestroySemaphore(device, timeline.semaphore, nullptr);
+    }
+    timelines.clear();
+  }
+
+  uint64_t VLKDevice::Submit(VkQueue queue, VkCommandBuffer command_buffer, uint64_t after, VkSemaphore wait, VkSemaphore signal)
+  {
+    std::vector<VkSemaphore> waits;
+    std::vector<uint64_t> wait_values;
+    std::vector<VkPipelineStageFlags> stages;
+
+    // Other queues are awaited up to their last submission not later than the point,
+    // the queue itself is ordered by submission
+    for (const auto& timeline : timelines)
+    {
+      if (timeline.queue == queue) continue;
+
+      const auto it = std::upper_bound(timeline.pending.begin(), timeline.pending.end(), after);
+      if (it == timeline.pending.begin()) continue;
+
+      waits.push_back(timeline.semaphore);
+      wait_values.push_back(*std::prev(it));
+      stages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+    if (wait)
+    {
+      waits.push_back(wait);
+      wait_values.push_back(0);
+      stages.push_back(VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    }
+
+    const auto timeline = std::find_if(timelines.begin(), timelines.end(), [queue](const Timeline& timeline) { return timeline.queue == queue; });
+    BLAST_ASSERT(timeline != timelines.end());
+
+    point += 1;
+    std::vector<VkSemaphore> signals{ timeline->semaphore };
+    std::vector<uint64_t> signal_values{ point };
+    if (signal)
     {
-      vkDestroyFence(device, fence, nullptr);
-      fence = nullptr;
+      signals.push_back(signal);
+      signal_values.push_back(0);
+    }
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.waitSemaphoreValueCount = uint32_t(wait_values.size());
+    timeline_info.pWaitSemaphoreValues = wait_values.data();
+    timeline_info.signalSemaphoreValueCount = uint32_t(signal_values.size());
+    timeline_info.pSignalSemaphoreValues = signal_values.data();
+
+    VkSubmitInfo submit_info = {};
+    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext = &timeline_info;
+    submit_info.waitSemaphoreCount = uint32_t(waits.size());
+    submit_info.pWaitSemaphores = waits.data();
+    submit_info.pWaitDstStageMask = stages.data();
+    submit_info.commandBufferCount = command_buffer ? 1 : 0;
+    submit_info.pCommandBuffers = command_buffer ? &command_buffer : nullptr;
+    submit_info.signalSemaphoreCount = uint32_t(signals.size());
+    submit_info.pSignalSemaphores = signals.data();
+    BLAST_ASSERT(VK_SUCCESS == vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE));
+
+    timeline->pending.push_back(point);
+    return point;
+  }
+
+  bool VLKDevice::IsComplete(uint64_t point)
+  {
+    for (auto& timeline : timelines)
+    {
+      if (timeline.pending.empty() || timeline.pending.front() > point) continue;
+
+      auto value = uint64_t(0);
+      BLAST_ASSERT(VK_SUCCESS == vkGetSemaphoreCounterValue(device, timeline.semaphore, &value));
+      timeline.pending.erase(timeline.pending.begin(), std::upper_bound(timeline.pending.begin(), timeline.pending.end(), value));
+
+      if (!timeline.pending.empty() && timeline.pending.front() <= point) return false;
+    }
+    return true;
+  }
+
+  void VLKDevice::Wait(uint64_t point)
+  {
+    for (auto& timeline : timelines)
+    {
+      const auto it = std::upper_bound(timeline.pending.begin(), timeline.pending.end(), point);
+      if (it == timeline.pending.begin()) continue;
+
+      const auto value = *std::prev(it);
+      VkSemaphoreWaitInfo wait_info = {};
+      wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+      wait_info.semaphoreCount = 1;
+      wait_info.pSemaphores = &timeline.semaphore;
+      wait_info.pValues = &value;
+      BLAST_ASSERT(VK_SUCCESS == vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+
+      timeline.pending.erase(timeline.pending.begin(), it);
+    }
+
+    Collect();
+  }
+
+  void VLKDevice::OnComplete(uint64_t point, std::function<void()> callback)
+  {
+    callbacks.emplace(point, std::move(callback));
+  }
+
+  void VLKDevice::Retire(std::shared_ptr<void> object)
+  {
+    // Nothing records which submission used an object last, so everything submitted so far is awaited
+    OnComplete(point, [object]() {});
+  }
+
+  void VLKDevice::Collect()
+  {
+    // Callbacks run in point order, each once everything submitted up to its point has finished
+    while (!callbacks.empty() && IsComplete(callbacks.begin()->first))
+    {
+      auto callback = std::move(callbacks.begin()->second);
+      callbacks.erase(callbacks.begin());
+      callback();
     }
   }
 
@@ -641,7 +966,7 @@ namespace RayGene3D
     const auto requirements = GetRequirements(buffer);
     const auto property = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
     const auto index = GetMemoryIndex(property, requirements.memoryTypeBits);
-    const auto memory = AllocateMemory(requirements.size, index, false);
+    const auto memory = AllocateMemory(requirements.size, index, false, CATEGORY_STAGING, "staging");
 
     BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device, buffer, memory, 0));
 
@@ -654,7 +979,7 @@ namespace RayGene3D
   {
     if (staging_memory)
     {
-      vkFreeMemory(device, staging_memory, nullptr);
+      FreeMemory(staging_memory);
       staging_memory = nullptr;
     }
 
@@ -668,22 +993,23 @@ namespace RayGene3D
 
   void VLKDevice::CreateScratch()
   {
-    if (!ray_tracing_supported) return;
+    if (!ray_tracing_supported || scratch_size == 0) return;
 
-    const auto size = scratch_size;
+    // Buffer address alignment may be coarser than the scratch one, so one extra alignment is kept to round the base up
+    const auto alignment = GetScratchAlignment();
+    const auto size = scratch_size + alignment;
     const auto usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
     const auto buffer = CreateBuffer(size, usage);
     const auto requirements = GetRequirements(buffer);
-    const auto property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    const auto index = GetMemoryIndex(property, requirements.memoryTypeBits);
-    const auto memory = AllocateMemory(requirements.size, index, true);
+    const auto index = GetMemoryIndex(MEMORY_DEVICE, requirements.memoryTypeBits, requirements.size);
+    const auto memory = AllocateMemory(requirements.size, index, true, CATEGORY_STRUCTURE, "scratch");
 
     BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device, buffer, memory, 0));
 
     scratch_buffer = buffer;
     scratch_memory = memory;
 
-    scratch_address = GetAddress(buffer);
+    scratch_address = (GetAddress(buffer) + alignment - 1) / alignment * alignment;
   }
 
 
@@ -694,7 +1020,7 @@ namespace RayGene3D
 
     if (scratch_memory)
     {
-      vkFreeMemory(device, scratch_memory, nullptr);
+      FreeMemory(scratch_memory);
       scratch_memory = nullptr;
     }
 
@@ -703,6 +1029,425 @@ namespace RayGene3D
       vkDestroyBuffer(device, scratch_buffer, nullptr);
       scratch_buffer = nullptr;
     }
+
+    scratch_address = 0;
+  }
+
+  void VLKDevice::CreateRing()
+  {
+    Resource::BufferDesc desc;
+    desc.usage = Usage(USAGE_SHADER_RESOURCE | USAGE_VERTEX_ARRAY | USAGE_INDEX_ARRAY | USAGE_CONSTANT_DATA | USAGE_ARGUMENT_LIST);
+    desc.stride = 256;
+    desc.count = uint32_t(ring_size / desc.stride);
+    ring = std::shared_ptr<Resource>(new VLKResource("ring", *this, desc, Resource::HINT_DYNAMIC_BUFFER));
+
+    ring_head = 0;
+    ring_fill = 0;
+    ring_frame = 0;
+  }
+
+  void VLKDevice::DestroyRing()
+  {
+    ring.reset();
+  }
+
+  std::pair<VkDeviceMemory, VkDeviceSize> VLKDevice::AllocatePage(uint32_t bits)
+  {
+    const auto index = GetMemoryIndex(MEMORY_DEVICE, bits, page_size);
+
+    auto chunk = std::find_if(chunks.begin(), chunks.end(),
+      [index](const Chunk& chunk) { return chunk.index == index && !chunk.free.empty(); });
+
+    // Pages are carved out of larger chunks to stay far from the allocation count limit
+    if (chunk == chunks.end())
+    {
+      auto& created = chunks.emplace_back();
+      created.index = index;
+      created.memory = AllocateMemory(page_size * chunk_pages, index, false, CATEGORY_PAGES, "pages");
+      for (uint32_t i = chunk_pages; i > 0; --i) created.free.push_back(i - 1);
+      chunk = std::prev(chunks.end());
+    }
+
+    const auto slot = chunk->free.back();
+    chunk->free.pop_back();
+    return { chunk->memory, VkDeviceSize(slot) * page_size };
+  }
+
+  void VLKDevice::FreePage(VkDeviceMemory memory, VkDeviceSize offset)
+  {
+    const auto chunk = std::find_if(chunks.begin(), chunks.end(), [memory](const Chunk& chunk) { return chunk.memory == memory; });
+    if (chunk == chunks.end()) return; // released with the device already
+    chunk->free.push_back(uint32_t(offset / page_size));
+  }
+
+  void VLKDevice::DestroyPages()
+  {
+    for (const auto& chunk : chunks)
+    {
+      FreeMemory(chunk.memory);
+    }
+    chunks.clear();
+  }
+
+  uint64_t VLKDevice::BindSparse(VkBindSparseInfo bind_info)
+  {
+    const auto timeline = std::find_if(timelines.begin(), timelines.end(), [this](const Timeline& timeline) { return timeline.queue == queue; });
+    BLAST_ASSERT(timeline != timelines.end());
+
+    point += 1;
+
+    VkTimelineSemaphoreSubmitInfo timeline_info = {};
+    timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timeline_info.signalSemaphoreValueCount = 1;
+    timeline_info.pSignalSemaphoreValues = &point;
+
+    bind_info.sType = VK_STRUCTURE_TYPE_BIND_SPARSE_INFO;
+    bind_info.pNext = &timeline_info;
+    bind_info.signalSemaphoreCount = 1;
+    bind_info.pSignalSemaphores = &timeline->semaphore;
+    BLAST_ASSERT(VK_SUCCESS == vkQueueBindSparse(queue, 1, &bind_info, VK_NULL_HANDLE));
+
+    timeline->pending.push_back(point);
+    return point;
+  }
+
+  VLKDevice::Allocation VLKDevice::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+  {
+    const auto resource = reinterpret_cast<VLKResource*>(ring.get());
+
+    // Allocations never straddle the end, the skipped tail stays in flight with the frame
+    auto offset = (ring_head + alignment - 1) / alignment * alignment;
+    if (offset + size > ring_size) offset = 0;
+    const auto taken = (offset >= ring_head ? offset - ring_head : ring_size - ring_head) + size;
+
+    if (ring_fill + taken > ring_size) Wait(point);
+    BLAST_ASSERT(ring_fill + taken <= ring_size);
+
+    ring_head = offset + size;
+    ring_fill += taken;
+    ring_frame += taken;
+
+    return { resource->GetBuffer(), offset, reinterpret_cast<uint8_t*>(resource->Map()) + offset };
+  }
+
+  void VLKDevice::DestroyTransient()
+  {
+    if (transient_memory)
+    {
+      FreeMemory(transient_memory);
+      transient_memory = nullptr;
+    }
+
+    transient_size = 0;
+  }
+
+  void VLKDevice::Compile()
+  {
+    struct Use
+    {
+      const Resource* resource{ nullptr };
+      bool write{ false };
+      bool attachment{ false };
+    };
+    std::vector<std::vector<Use>> uses(schedule.size());
+    for (uint32_t i = 0; i < uint32_t(schedule.size()); ++i)
+    {
+      const auto pass = reinterpret_cast<VLKPass*>(schedule[i].get());
+
+      std::vector<std::shared_ptr<View>> inputs;
+      pass->CollectInputs(inputs);
+
+      schedule[i]->VisitView([&uses, &inputs, i](const std::shared_ptr<View>& view, bool write)
+      {
+        const auto attachment = (view->GetUsage() & (USAGE_RENDER_TARGET | USAGE_DEPTH_STENCIL)) != 0
+          || std::find(inputs.begin(), inputs.end(), view) != inputs.end();
+        uses[i].push_back({ &view->GetResource(), write, attachment });
+        return false;
+      });
+    }
+
+    // Consecutive graphic passes reading the attachments of the previous ones become subpasses
+    std::vector<std::vector<VLKPass*>> groups;
+    std::vector<uint32_t> group_ids(schedule.size());
+    for (uint32_t i = 0; i < uint32_t(schedule.size()); ++i)
+    {
+      const auto pass = reinterpret_cast<VLKPass*>(schedule[i].get());
+      if (groups.empty() || !pass->CanMerge(groups.back()))
+      {
+        groups.emplace_back();
+      }
+      groups.back().push_back(pass);
+      group_ids[i] = uint32_t(groups.size() - 1);
+    }
+
+    // Transient lifetimes are spans of scheduled passes between the first and the last use
+    struct Item
+    {
+      VLKResource* resource{ nullptr };
+      uint32_t first{ 0 };
+      uint32_t last{ 0 };
+      VkMemoryRequirements requirements{};
+      VkDeviceSize offset{ 0 };
+    };
+    std::vector<Item> items;
+    std::map<const Resource*, size_t> lookup;
+    for (uint32_t i = 0; i < uint32_t(uses.size()); ++i)
+    {
+      for (const auto& use : uses[i])
+      {
+        if ((use.resource->GetHint() & Resource::HINT_TRANSIENT_IMAGE) == 0) continue;
+
+        const auto it = lookup.find(use.resource);
+        if (it == lookup.end())
+        {
+          lookup[use.resource] = items.size();
+          items.push_back({ reinterpret_cast<VLKResource*>(const_cast<Resource*>(use.resource)), i, i });
+        }
+        else
+        {
+          items[it->second].last = i;
+        }
+      }
+    }
+
+    const auto root_fn = [this](const Resource* resource)
+    {
+      return resource == screen.get() || (resource->GetHint() & (Resource::HINT_DYNAMIC_BUFFER | Resource::HINT_READBACK_BUFFER)) != 0;
+    };
+    const auto read_fn = [&uses, &group_ids](const Resource* resource, uint32_t first, uint32_t last, uint32_t skip)
+    {
+      for (uint32_t i = first; i <= last && i < uint32_t(uses.size()); ++i)
+      {
+        if (i != skip && group_ids[i] == group_ids[skip]) continue;
+        for (const auto& use : uses[i]) if (use.resource == resource && !use.write) return true;
+      }
+      return false;
+    };
+
+    // Transient contents die with the last use, persistent ones are kept while anything reads them,
+    // reads by the other subpasses of the same render pass never leave the tile
+    for (uint32_t i = 0; i < uint32_t(schedule.size()); ++i)
+    {
+      const auto loaded_fn = [&items, &lookup, i](const Resource* resource)
+      {
+        const auto it = lookup.find(resource);
+        return it == lookup.end() || items[it->second].first != i;
+      };
+      const auto stored_fn = [&items, &lookup, &root_fn, &read_fn, i](const Resource* resource)
+      {
+        if (root_fn(resource)) return true;
+        const auto it = lookup.find(resource);
+        return it == lookup.end() ? read_fn(resource, 0, uint32_t(-1), i) : read_fn(resource, i + 1, items[it->second].last, i);
+      };
+      reinterpret_cast<VLKPass*>(schedule[i].get())->Infer(loaded_fn, stored_fn);
+    }
+
+    Wait(point);
+
+    // Images bind memory only once, so placed ones are re-created before the heap changes
+    for (auto& item : items)
+    {
+      auto attachment_only = group_ids[item.first] == group_ids[item.last];
+      for (uint32_t i = item.first; i <= item.last; ++i)
+      {
+        for (const auto& use : uses[i]) if (use.resource == item.resource && !use.attachment) attachment_only = false;
+      }
+      item.resource->SetLazy(attachment_only && !root_fn(item.resource));
+
+      item.resource->Discard();
+      item.resource->Initialize();
+      item.requirements = GetRequirements(item.resource->GetImage());
+    }
+    DestroyTransient();
+
+    std::vector<size_t> order;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+      if (!items[i].resource->GetLazy()) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&items](size_t a, size_t b) { return items[a].requirements.size > items[b].requirements.size; });
+
+    // Largest first, each one at the lowest offset free of images alive at the same time
+    auto bits = uint32_t(-1);
+    auto unaliased = VkDeviceSize(0);
+    std::vector<size_t> placed;
+    for (const auto index : order)
+    {
+      auto& item = items[index];
+      const auto size = item.requirements.size;
+      const auto alignment = std::max(VkDeviceSize(1), item.requirements.alignment);
+
+      std::vector<std::pair<VkDeviceSize, VkDeviceSize>> busy;
+      for (const auto other : placed)
+      {
+        const auto& placed_item = items[other];
+        if (placed_item.first <= item.last && item.first <= placed_item.last)
+        {
+          busy.emplace_back(placed_item.offset, placed_item.offset + placed_item.requirements.size);
+        }
+      }
+      std::sort(busy.begin(), busy.end());
+
+      auto offset = VkDeviceSize(0);
+      for (const auto& range : busy)
+      {
+        if (offset + size <= range.first) break;
+        offset = std::max(offset, (range.second + alignment - 1) / alignment * alignment);
+      }
+
+      item.offset = offset;
+      transient_size = std::max(transient_size, offset + size);
+      unaliased += size;
+      bits &= item.requirements.memoryTypeBits;
+      placed.push_back(index);
+    }
+
+    if (transient_size > 0)
+    {
+      BLAST_ASSERT(bits != 0);
+      const auto index = GetMemoryIndex(MEMORY_DEVICE, bits, transient_size);
+      BLAST_LOG("Allocating %llu bytes for %d transient images (%llu bytes unaliased)", static_cast<unsigned long long>(transient_size),
+        uint32_t(placed.size()), static_cast<unsigned long long>(unaliased));
+      transient_memory = AllocateMemory(transient_size, index, false, CATEGORY_IMAGE, "transient");
+    }
+
+    std::map<uint32_t, std::vector<VLKResource*>> acquires;
+    for (const auto index : placed)
+    {
+      const auto& item = items[index];
+
+      std::vector<VLKResource*> aliases;
+      for (const auto other : placed)
+      {
+        const auto& other_item = items[other];
+        if (other == index) continue;
+        if (other_item.offset < item.offset + item.requirements.size && item.offset < other_item.offset + other_item.requirements.size)
+        {
+          aliases.push_back(other_item.resource);
+        }
+      }
+      item.resource->Place(transient_memory, item.offset, aliases);
+    }
+    for (const auto& item : items)
+    {
+      acquires[item.first].push_back(item.resource);
+    }
+
+    for (const auto& pass : passes)
+    {
+      auto vlk_pass = reinterpret_cast<VLKPass*>(pass.get());
+      vlk_pass->SetSubpasses({ vlk_pass });
+    }
+    for (const auto& group : groups)
+    {
+      if (group.size() > 1) group.front()->SetSubpasses(group);
+    }
+
+    // Render passes pick up the inferred operations, framebuffers and descriptor sets the re-created views,
+    // pipelines the render pass and subpass they are merged into
+    for (const auto& pass : passes)
+    {
+      auto vlk_pass = reinterpret_cast<VLKPass*>(pass.get());
+      vlk_pass->SetAcquires({});
+      vlk_pass->Discard();
+      vlk_pass->Initialize();
+    }
+    for (const auto& pass : passes)
+    {
+      pass->VisitConfig([](const std::shared_ptr<Config>& config)
+      {
+        config->VisitBatch([](const std::shared_ptr<Batch>& batch)
+        {
+          reinterpret_cast<VLKBatch*>(batch.get())->UpdateSets();
+          reinterpret_cast<VLKBatch*>(batch.get())->UpdatePipeline();
+          return false;
+        });
+        return false;
+      });
+    }
+    for (uint32_t i = 0; i < uint32_t(schedule.size()); ++i)
+    {
+      reinterpret_cast<VLKPass*>(schedule[i].get())->SetAcquires(acquires[i]);
+    }
+  }
+
+  void VLKDevice::ReserveScratch(VkDeviceSize size)
+  {
+    scratch_use = frame;
+    if (size <= scratch_size && scratch_buffer) return;
+
+    const auto granularity = VkDeviceSize(4 * 1024 * 1024);
+    const auto aligned = (size + granularity - 1) / granularity * granularity;
+
+    Wait(point);
+    DestroyScratch();
+    scratch_size = std::max(aligned, scratch_size);
+    CreateScratch();
+
+    BLAST_LOG("Scratch arena is grown to %llu bytes", static_cast<unsigned long long>(scratch_size));
+  }
+
+  void VLKDevice::TrimScratch()
+  {
+    if (!scratch_buffer) return;
+
+    Wait(point);
+    DestroyScratch();
+    scratch_size = 0;
+  }
+
+  void VLKDevice::Dispatch(const std::function<void()>& task, uint32_t count) const
+  {
+    if (dispatcher)
+    {
+      dispatcher(task, count);
+      return;
+    }
+
+    std::vector<std::thread> workers;
+    for (uint32_t i = 1; i < count; ++i)
+    {
+      workers.emplace_back(task);
+    }
+    task();
+
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+  }
+
+  VkResult VLKDevice::Defer(const std::function<VkResult(VkDeferredOperationKHR)>& command) const
+  {
+    VkDeferredOperationKHR operation{ nullptr };
+    BLAST_ASSERT(VK_SUCCESS == vkCreateDeferredOperationKHR(device, nullptr, &operation));
+
+    auto result = command(operation);
+    if (result == VK_OPERATION_DEFERRED_KHR)
+    {
+      const auto workers = std::max(1u, std::thread::hardware_concurrency());
+      const auto count = std::min(vkGetDeferredOperationMaxConcurrencyKHR(device, operation), workers);
+
+      Dispatch([this, operation]()
+        {
+          auto status = vkDeferredOperationJoinKHR(device, operation);
+          while (status == VK_THREAD_IDLE_KHR)
+          {
+            std::this_thread::yield();
+            status = vkDeferredOperationJoinKHR(device, operation);
+          }
+        }, std::max(1u, count));
+
+      result = vkGetDeferredOperationResultKHR(device, operation);
+    }
+    else if (result == VK_OPERATION_NOT_DEFERRED_KHR)
+    {
+      result = VK_SUCCESS;
+    }
+
+    vkDestroyDeferredOperationKHR(device, operation, nullptr);
+
+    return result;
   }
 
   uint32_t VLKDevice::GetMemoryIndex(VkMemoryPropertyFlags flags, uint32_t bits) const
@@ -724,18 +1469,23 @@ namespace RayGene3D
     return vkGetBufferDeviceAddress(device, &info);
   };
 
-  VkBuffer VLKDevice::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBufferCreateFlags flags) const
+  VkBuffer VLKDevice::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBufferCreateFlags flags, bool external) const
   {
     VkBuffer buffer{ nullptr };
 
+    VkExternalMemoryBufferCreateInfo external_info{};
+    external_info.sType         = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+    external_info.handleTypes   = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
     VkBufferCreateInfo info{};
     info.sType                  = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    info.pNext                  = external ? &external_info : nullptr;
     info.size                   = size;
     info.usage                  = usage;
     info.flags                  = flags;
-    info.sharingMode            = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount  = 0;
-    info.pQueueFamilyIndices    = nullptr;
+    info.sharingMode            = families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount  = families.size() > 1 ? uint32_t(families.size()) : 0;
+    info.pQueueFamilyIndices    = families.size() > 1 ? families.data() : nullptr;
 
     BLAST_ASSERT(VK_SUCCESS == vkCreateBuffer(device, &info, nullptr, &buffer));
 
@@ -758,9 +1508,9 @@ namespace RayGene3D
     info.samples                = VK_SAMPLE_COUNT_1_BIT;
     info.tiling                 = VK_IMAGE_TILING_OPTIMAL;
     info.usage                  = usage;
-    info.sharingMode            = VK_SHARING_MODE_EXCLUSIVE;
-    info.queueFamilyIndexCount  = 0;
-    info.pQueueFamilyIndices    = nullptr;
+    info.sharingMode            = families.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+    info.queueFamilyIndexCount  = families.size() > 1 ? uint32_t(families.size()) : 0;
+    info.pQueueFamilyIndices    = families.size() > 1 ? families.data() : nullptr;
     info.initialLayout          = VK_IMAGE_LAYOUT_UNDEFINED; //properties.empty() ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PREINITIALIZED;
     BLAST_ASSERT(VK_SUCCESS == vkCreateImage(device, &info, nullptr, &image));
 
@@ -783,7 +1533,164 @@ namespace RayGene3D
     return requirements;
   };
 
-  VkDeviceMemory VLKDevice::AllocateMemory(VkDeviceSize size, uint32_t index, bool addressable) const
+  const char* VLKDevice::GetClassName(MemoryClass memory_class)
+  {
+    switch (memory_class)
+    {
+    case MEMORY_DEVICE: return "device";
+    case MEMORY_UPLOAD: return "upload";
+    case MEMORY_READBACK: return "readback";
+    case MEMORY_TRANSIENT: return "transient";
+    case MEMORY_SYSTEM: return "system";
+    }
+    return "unknown";
+  }
+
+  const char* VLKDevice::GetCategoryName(Category category)
+  {
+    switch (category)
+    {
+    case CATEGORY_BUFFER: return "buffers";
+    case CATEGORY_IMAGE: return "images";
+    case CATEGORY_STRUCTURE: return "structures";
+    case CATEGORY_STAGING: return "staging";
+    case CATEGORY_TABLE: return "tables";
+    case CATEGORY_PAGES: return "pages";
+    default: return "unknown";
+    }
+  }
+
+  VkDeviceSize VLKDevice::GetHeapBudget(uint32_t heap) const
+  {
+    // A quarter of every heap is left for the driver, the compositor and other processes
+    if (!memory_budget_supported) return memory.memoryHeaps[heap].size / 4 * 3;
+
+    // The driver budget covers the whole process, memory not allocated here is taken off
+    const auto foreign = memory_budget.heapUsage[heap] > heap_usage[heap] ? memory_budget.heapUsage[heap] - heap_usage[heap] : 0;
+    return memory_budget.heapBudget[heap] > foreign ? memory_budget.heapBudget[heap] - foreign : 0;
+  }
+
+  void VLKDevice::UpdateBudget()
+  {
+    if (!memory_budget_supported) return;
+
+    memory_budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+    memory_budget.pNext = nullptr;
+    VkPhysicalDeviceMemoryProperties2 memory_properties = {};
+    memory_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+    memory_properties.pNext = &memory_budget;
+    vkGetPhysicalDeviceMemoryProperties2(adapter, &memory_properties);
+  }
+
+  std::string VLKDevice::Report(uint32_t top)
+  {
+    UpdateBudget();
+
+    std::stringstream ss;
+    const auto mb_fn = [](VkDeviceSize size) { return double(size) / (1024.0 * 1024.0); };
+
+    ss << "Memory report [" << name << "], " << blocks.size() << " allocations" << std::endl;
+
+    std::vector<std::array<VkDeviceSize, CATEGORY_COUNT>> heap_categories(memory.memoryHeapCount);
+    std::vector<std::array<uint32_t, CATEGORY_COUNT>> heap_counts(memory.memoryHeapCount);
+    std::map<std::string, VkDeviceSize> owners;
+    for (const auto& [handle, block] : blocks)
+    {
+      const auto heap = memory.memoryTypes[block.index].heapIndex;
+      heap_categories[heap][block.category] += block.size;
+      heap_counts[heap][block.category] += 1;
+      owners[block.owner.empty() ? GetCategoryName(block.category) : block.owner] += block.size;
+    }
+
+    for (uint32_t i = 0; i < memory.memoryHeapCount; ++i)
+    {
+      ss << "  heap " << i << (memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT ? " (device)" : " (host)")
+        << ": size " << mb_fn(memory.memoryHeaps[i].size) << " MB, allocated " << mb_fn(heap_usage[i]) << " MB";
+      if (memory_budget_supported)
+      {
+        ss << ", driver usage " << mb_fn(memory_budget.heapUsage[i]) << " MB, driver budget " << mb_fn(memory_budget.heapBudget[i]) << " MB";
+      }
+      ss << std::endl;
+
+      for (uint32_t j = 0; j < CATEGORY_COUNT; ++j)
+      {
+        if (heap_counts[i][j] == 0) continue;
+        ss << "    " << GetCategoryName(Category(j)) << ": " << mb_fn(heap_categories[i][j]) << " MB in " << heap_counts[i][j] << " allocations" << std::endl;
+      }
+    }
+
+    std::vector<std::pair<std::string, VkDeviceSize>> consumers(owners.begin(), owners.end());
+    std::sort(consumers.begin(), consumers.end(), [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+    consumers.resize(std::min(consumers.size(), size_t(top)));
+
+    ss << "  residency: " << evicted_count << " evictions (" << mb_fn(evicted_bytes) << " MB), "
+      << restored_count << " restores (" << mb_fn(restored_bytes) << " MB)" << std::endl;
+
+    ss << "  top " << consumers.size() << " consumers:" << std::endl;
+    for (const auto& [owner, size] : consumers)
+    {
+      ss << "    " << owner << ": " << mb_fn(size) << " MB" << std::endl;
+    }
+
+    return ss.str();
+  }
+
+  void VLKDevice::Snapshot(const std::string& path, uint32_t top)
+  {
+    std::ofstream fs(path, std::ios::app);
+    if (!fs) { BLAST_LOG("Failed to write memory snapshot [%s]", path.c_str()); return; }
+
+    fs << "frame " << frame << std::endl << Report(top) << std::endl;
+  }
+
+  uint32_t VLKDevice::GetMemoryIndex(MemoryClass memory_class, uint32_t bits, VkDeviceSize size) const
+  {
+    const auto host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    const auto visible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    const auto cached = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    const auto local = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    const auto lazy = VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+
+    // Required and avoided properties in order of preference, the first type fitting its heap budget wins
+    std::vector<std::pair<VkMemoryPropertyFlags, VkMemoryPropertyFlags>> preferences;
+    switch (memory_class)
+    {
+    case MEMORY_DEVICE: preferences = { { local, host }, { local, 0 }, { 0, 0 } }; break;
+    case MEMORY_UPLOAD: preferences = { { local | visible, 0 }, { visible, 0 } }; break;
+    case MEMORY_READBACK: preferences = { { cached, 0 }, { visible, 0 } }; break;
+    case MEMORY_TRANSIENT: preferences = { { local | lazy, 0 }, { local, host }, { local, 0 }, { 0, 0 } }; break;
+    case MEMORY_SYSTEM: preferences = { { visible, local }, { visible, 0 } }; break;
+    }
+
+    const auto find_fn = [this, bits, size](VkMemoryPropertyFlags required, VkMemoryPropertyFlags avoided, bool budgeted)
+    {
+      for (uint32_t i = 0; i < memory.memoryTypeCount; ++i)
+      {
+        const auto flags = memory.memoryTypes[i].propertyFlags;
+        if (((bits >> i) & 1) == 0 || (flags & required) != required || (flags & avoided) != 0) continue;
+
+        const auto heap = memory.memoryTypes[i].heapIndex;
+        if (!budgeted || heap_usage[heap] + size <= GetHeapBudget(heap)) return i;
+      }
+      return memory.memoryTypeCount;
+    };
+
+    for (const auto& [required, avoided] : preferences)
+    {
+      const auto index = find_fn(required, avoided, true);
+      if (index < memory.memoryTypeCount) return index;
+    }
+
+    // Over budget everywhere, the driver gets the final word on the preferred type
+    for (const auto& [required, avoided] : preferences)
+    {
+      const auto index = find_fn(required, avoided, false);
+      if (index < memory.memoryTypeCount) return index;
+    }
+    return memory.memoryTypeCount;
+  }
+
+  VkDeviceMemory VLKDevice::AllocateMemory(VkDeviceSize size, uint32_t index, bool addressable, Category category, const std::string& owner)
   {
     VkDeviceMemory memory{ nullptr };
 
@@ -796,11 +1703,234 @@ namespace RayGene3D
     info.pNext             = addressable ? &flags_info : nullptr;
     info.allocationSize    = size;
     info.memoryTypeIndex   = index;
-    BLAST_ASSERT(VK_SUCCESS == vkAllocateMemory(device, &info, nullptr, &memory));
+    auto result = vkAllocateMemory(device, &info, nullptr, &memory);
+
+    // Cold resources make room before the allocation is given up on
+    if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY && Evict(this->memory.memoryTypes[index].heapIndex, size))
+    {
+      result = vkAllocateMemory(device, &info, nullptr, &memory);
+    }
+    BLAST_ASSERT(VK_SUCCESS == result);
+
+    blocks[memory] = { index, size, category, owner };
+    heap_usage[this->memory.memoryTypes[index].heapIndex] += size;
 
     return memory;
   };
 
+  bool VLKDevice::GetHostImportable(const void* data, VkDeviceSize size) const
+  {
+    return host_import_supported && data != nullptr && size != 0
+      && reinterpret_cast<uintptr_t>(data) % host_import_alignment == 0 && size % host_import_alignment == 0;
+  }
+
+  VkDeviceMemory VLKDevice::ImportMemory(const void* data, VkDeviceSize size, uint32_t bits, Category category, const std::string& owner)
+  {
+    if (!GetHostImportable(data, size)) return nullptr;
+
+    VkMemoryHostPointerPropertiesEXT pointer_properties{};
+    pointer_properties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+    if (VK_SUCCESS != vkGetMemoryHostPointerPropertiesEXT(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+      data, &pointer_properties)) return nullptr;
+
+    // Host visible types only, so host-resident buffers can still be mapped
+    const auto index = GetMemoryIndex(MEMORY_SYSTEM, bits & pointer_properties.memoryTypeBits, 0);
+    if (index == this->memory.memoryTypeCount) return nullptr;
+
+    // The driver only reads and writes through the pointer, it never owns the pages
+    VkImportMemoryHostPointerInfoEXT import_info{};
+    import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    import_info.pHostPointer = const_cast<void*>(data);
+
+    VkMemoryAllocateInfo info{};
+    info.sType             = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    info.pNext             = &import_info;
+    info.allocationSize    = size;
+    info.memoryTypeIndex   = index;
+
+    VkDeviceMemory memory{ nullptr };
+    if (VK_SUCCESS != vkAllocateMemory(device, &info, nullptr, &memory)) return nullptr;
+
+    blocks[memory] = { index, size, category, owner };
+    heap_usage[this->memory.memoryTypes[index].heapIndex] += size;
+
+    return memory;
+  }
+
+  bool VLKDevice::Evict(uint32_t heap, VkDeviceSize size)
+  {
+    // Least recently used first, only what has been idle long enough to not be needed by pending work
+    std::vector<VLKResource*> candidates;
+    for (const auto& resource : resources)
+    {
+      const auto vlk_resource = reinterpret_cast<VLKResource*>(resource.get());
+      if (!vlk_resource->GetEvictable() || vlk_resource->GetEvicted()) continue;
+      if (vlk_resource->GetLastUse() + residency_age > frame) continue;
+
+      const auto it = blocks.find(vlk_resource->GetMemory());
+      if (it == blocks.end() || this->memory.memoryTypes[it->second.index].heapIndex != heap) continue;
+
+      candidates.push_back(vlk_resource);
+    }
+    std::sort(candidates.begin(), candidates.end(),
+      [](const VLKResource* lhs, const VLKResource* rhs) { return lhs->GetLastUse() < rhs->GetLastUse(); });
+
+    VkDeviceSize freed = 0;
+    for (const auto candidate : candidates)
+    {
+      if (freed >= size) break;
+
+      const auto bytes = blocks.at(candidate->GetMemory()).size;
+      if (!candidate->Relocate(true)) continue;
+
+      freed += bytes;
+      evicted_bytes += bytes;
+      evicted_count += 1;
+    }
+
+    if (freed > 0)
+    {
+      Patch();
+    }
+
+    return freed >= size;
+  }
+
+  void VLKDevice::UpdateResidency()
+  {
+    for (const auto& pass : schedule)
+    {
+      pass->VisitView([this](const std::shared_ptr<View>& view, bool write)
+      {
+        reinterpret_cast<VLKResource*>(&view->GetResource())->Touch(frame);
+        return false;
+      });
+    }
+
+    // Scratch arena outlives the builds that grew it and goes away once unused for as long as an evictable resource
+    if (scratch_buffer && scratch_use + residency_age <= frame)
+    {
+      TrimScratch();
+    }
+
+    // Streaming images swap in finished uploads, then follow the detail asked for
+    auto restored = false;
+    for (const auto& resource : resources)
+    {
+      const auto vlk_resource = reinterpret_cast<VLKResource*>(resource.get());
+      if ((vlk_resource->GetHint() & Resource::HINT_STREAMING_IMAGE) == 0) continue;
+
+      restored |= vlk_resource->Swap();
+      vlk_resource->Stream(vlk_resource->GetDetail());
+    }
+
+    // Evicted resources needed this frame come back while device heaps have room for them
+    for (const auto& resource : resources)
+    {
+      const auto vlk_resource = reinterpret_cast<VLKResource*>(resource.get());
+      if (!vlk_resource->GetEvicted() || vlk_resource->GetLastUse() != frame) continue;
+
+      const auto bytes = blocks.at(vlk_resource->GetMemory()).size;
+      if (!vlk_resource->Relocate(false)) continue;
+
+      restored = true;
+      restored_bytes += bytes;
+      restored_count += 1;
+    }
+
+    if (restored)
+    {
+      Patch();
+    }
+
+    // Device heaps over budget give up their coldest resources
+    for (uint32_t i = 0; i < memory.memoryHeapCount; ++i)
+    {
+      if ((memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) == 0) continue;
+
+      const auto budget = GetHeapBudget(i);
+      if (heap_usage[i] <= budget) continue;
+
+      // Idle scratch memory is the cheapest to give back, builds reserve it again on demand
+      const auto scratch = blocks.find(scratch_memory);
+      if (scratch_buffer && scratch != blocks.end() && memory.memoryTypes[scratch->second.index].heapIndex == i)
+      {
+        TrimScratch();
+        if (heap_usage[i] <= budget) continue;
+      }
+
+      // The finest mipmaps of streaming images are dropped before any buffer is evicted
+      std::vector<VLKResource*> streamed;
+      for (const auto& resource : resources)
+      {
+        const auto vlk_resource = reinterpret_cast<VLKResource*>(resource.get());
+        if ((vlk_resource->GetHint() & Resource::HINT_STREAMING_IMAGE) == 0 || vlk_resource->GetStreaming()) continue;
+        if (vlk_resource->GetResident() >= vlk_resource->GetTail()) continue;
+
+        const auto it = blocks.find(vlk_resource->GetMemory());
+        if (it == blocks.end() || memory.memoryTypes[it->second.index].heapIndex != i) continue;
+
+        streamed.push_back(vlk_resource);
+      }
+      std::sort(streamed.begin(), streamed.end(),
+        [](const VLKResource* lhs, const VLKResource* rhs) { return lhs->GetLastUse() < rhs->GetLastUse(); });
+
+      // Dropping a mipmap frees about three quarters of an image once its replacement is swapped in
+      VkDeviceSize dropped = 0;
+      for (const auto resource : streamed)
+      {
+        if (dropped >= heap_usage[i] - budget) break;
+        if (resource->Stream(resource->GetResident() + 1)) dropped += blocks.at(resource->GetMemory()).size / 4 * 3;
+      }
+
+      if (dropped == 0) Evict(i, heap_usage[i] - budget);
+    }
+  }
+
+  void VLKDevice::Patch()
+  {
+    // Buffers moved to new handles, every descriptor set is written again
+    for (const auto& pass : passes)
+    {
+      pass->VisitConfig([](const std::shared_ptr<Config>& config)
+      {
+        config->VisitBatch([](const std::shared_ptr<Batch>& batch)
+        {
+          reinterpret_cast<VLKBatch*>(batch.get())->UpdateSets();
+          return false;
+        });
+        return false;
+      });
+    }
+  }
+
+  void VLKDevice::FreeMemory(VkDeviceMemory memory)
+  {
+    const auto it = blocks.find(memory);
+    if (it != blocks.end())
+    {
+      heap_usage[this->memory.memoryTypes[it->second.index].heapIndex] -= it->second.size;
+      blocks.erase(it);
+    }
+
+    vkFreeMemory(device, memory, nullptr);
+  }
+
+  void VLKDevice::InvalidateMemory(VkDeviceMemory memory) const
+  {
+    const auto it = blocks.find(memory);
+    if (it == blocks.end()) return;
+    if (this->memory.memoryTypes[it->second.index].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = memory;
+    range.offset = 0;
+    range.size = VK_WHOLE_SIZE;
+    BLAST_ASSERT(VK_SUCCESS == vkInvalidateMappedMemoryRanges(device, 1, &range));
+  }
+
   //void* VLKDevice::MapMemory(VkDeviceMemory memory) const
   //{
   //  void* mapped{ nullptr };
@@ -827,6 +1957,13 @@ namespace RayGene3D
       screen.reset();
     }
 
+    schedule.clear();
+    topology = 0;
+
+    // Retired objects still reference device memory and handles released below
+    callbacks.clear();
+    DestroyRing();
+
     //for (auto& pass : passes)
     //{
     //  if (pass) { /*BLAST_LOG("Discarding queue [%s]", name.c_str());*/ pass->Discard(); }
@@ -837,6 +1974,8 @@ namespace RayGene3D
     //  if (resource) { /*BLAST_LOG("Discarding resource [%s]", name.c_str());*/ resource->Discard(); }
     //}
 
+    DestroyTransient();
+    DestroyPages();
     DestroyScratch();
     DestroyStaging();
     DestroyFence();
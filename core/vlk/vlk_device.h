@@ -53,9 +53,69 @@ namespace RayGene3D
     VkPhysicalDeviceProperties properties{};
     VkPhysicalDeviceFeatures features{};
     VkPhysicalDeviceMemoryProperties memory{};
+    VkPhysicalDeviceIDProperties identity{};
+
+  public:
+    enum Category
+    {
+      CATEGORY_BUFFER = 0,
+      CATEGORY_IMAGE = 1,
+      CATEGORY_STRUCTURE = 2, // acceleration structures, their inputs and scratch
+      CATEGORY_STAGING = 3,
+      CATEGORY_TABLE = 4, // shader binding tables
+      CATEGORY_PAGES = 5, // backing of sparse resources
+      CATEGORY_COUNT = 6,
+    };
+    static const char* GetCategoryName(Category category);
+
+  protected:
+    struct Block
+    {
+      uint32_t index{ 0 };
+      VkDeviceSize size{ 0 };
+      Category category{ CATEGORY_BUFFER };
+      std::string owner;
+    };
+    std::map<VkDeviceMemory, Block> blocks;
+    std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heap_usage{};
+
+    bool sparse_supported{ false };
+    bool sparse_3d_supported{ false };
+    bool sparse{ true };
+    struct Chunk
+    {
+      VkDeviceMemory memory{ nullptr };
+      uint32_t index{ 0 };
+      std::vector<uint32_t> free; // page slots
+    };
+    std::vector<Chunk> chunks;
+    VkDeviceSize page_size{ 64 * 1024 };
+    uint32_t chunk_pages{ 256 };
+
+    bool memory_budget_supported{ false };
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memory_budget{};
+
+    bool host_import_supported{ false };
+    VkDeviceSize host_import_alignment{ 0 };
+
+    std::string snapshot_path;
+    uint32_t snapshot_period{ 0 };
+
+    uint64_t frame{ 0 };
+    uint32_t residency_age{ 3 }; // frames unused before a resource may be evicted
+    uint64_t evicted_bytes{ 0 };
+    uint64_t restored_bytes{ 0 };
+    uint32_t evicted_count{ 0 };
+    uint32_t restored_count{ 0 };
     
     bool ray_tracing_supported{ false };
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR ray_tracing_properties{};
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR acceleration_properties{};
+
+    bool host_build_supported{ false };
+    bool host_build{ false };
+    uint32_t geometry_budget{ 0 };
+    std::function<void(const std::function<void()>&, uint32_t)> dispatcher;
 
     bool mesh_shader_supported{ false };
     VkPhysicalDeviceMeshShaderPropertiesEXT mesh_shader_properties{};
@@ -64,9 +124,19 @@ namespace RayGene3D
     VkDevice device{ nullptr };
     uint32_t family{ uint32_t(-1) };
     VkQueue queue{ nullptr };
+    uint32_t compute_family{ uint32_t(-1) };
+    VkQueue compute_queue{ nullptr };
+    uint32_t transfer_family{ uint32_t(-1) };
+    VkQueue transfer_queue{ nullptr };
+    std::vector<uint32_t> families; // sharing every resource
 
     VkCommandPool command_pool{ nullptr };
-    VkCommandBuffer command_buffer{ nullptr };
+    VkCommandBuffer command_buffer{ nullptr }; // being recorded
+    VkCommandPool compute_pool{ nullptr };
+    VkCommandPool transfer_pool{ nullptr };
+
+    std::vector<VkCommandBuffer> graphic_buffers;
+    std::vector<VkCommandBuffer> compute_buffers;
 
     VkSurfaceKHR surface{ nullptr };
     VkSwapchainKHR swapchain{ nullptr };
@@ -75,7 +145,16 @@ namespace RayGene3D
 
     VkSemaphore imageAvailableSemaphore{ nullptr };
     VkSemaphore renderFinishedSemaphore{ nullptr };
-    VkFence fence{ nullptr };
+
+    struct Timeline
+    {
+      VkQueue queue{ nullptr };
+      VkSemaphore semaphore{ nullptr };
+      std::vector<uint64_t> pending; // submitted, not seen completed yet
+    };
+    std::vector<Timeline> timelines; // one per distinct queue
+    uint64_t point{ 0 };
+    std::multimap<uint64_t, std::function<void()>> callbacks;
 
     VkDebugUtilsMessengerEXT messenger{ nullptr };
 
@@ -86,7 +165,18 @@ namespace RayGene3D
     VkDeviceAddress scratch_address{ 0 };
     VkBuffer scratch_buffer{ nullptr };
     VkDeviceMemory scratch_memory{ nullptr };
-    VkDeviceSize scratch_size{ 64 * 1024 * 1024 };
+    VkDeviceSize scratch_size{ 0 };
+    VkDeviceSize scratch_limit{ 256 * 1024 * 1024 };
+    uint64_t scratch_use{ 0 }; // frame of the last reservation
+
+    VkDeviceMemory transient_memory{ nullptr };
+    VkDeviceSize transient_size{ 0 };
+
+    std::shared_ptr<Resource> ring; // persistently mapped, reclaimed per frame
+    VkDeviceSize ring_size{ 16 * 1024 * 1024 };
+    VkDeviceSize ring_head{ 0 };
+    VkDeviceSize ring_fill{ 0 }; // in flight, including skipped tails
+    VkDeviceSize ring_frame{ 0 }; // taken since the last frame was submitted
 
   public:
     VkBuffer GetStagingBuffer() const { return staging_buffer; }
@@ -98,34 +188,55 @@ namespace RayGene3D
     VkBuffer GetScratchBuffer() const { return scratch_buffer; }
     VkDeviceMemory GetScratchMemory() const { return scratch_memory; }
     VkDeviceSize GetScratchSize() const { return scratch_size; }
+    VkDeviceSize GetScratchAlignment() const { return std::max(VkDeviceSize(1), VkDeviceSize(acceleration_properties.minAccelerationStructureScratchOffsetAlignment)); }
+    void SetScratchLimit(VkDeviceSize scratch_limit) { this->scratch_limit = scratch_limit; }
+    VkDeviceSize GetScratchLimit() const { return scratch_limit; }
+    void ReserveScratch(VkDeviceSize size);
+    void TrimScratch();
 
+  public:
+    struct Allocation
+    {
+      VkBuffer buffer{ nullptr };
+      VkDeviceSize offset{ 0 };
+      void* data{ nullptr };
+    };
+    const std::shared_ptr<Resource>& GetRing() const { return ring; }
+    VkDeviceSize GetRingSize() const { return ring_size; }
+    Allocation Allocate(VkDeviceSize size, VkDeviceSize alignment = 256);
 
   public:
+    VkDeviceMemory GetTransientMemory() const { return transient_memory; }
+    VkDeviceSize GetTransientSize() const { return transient_size; }
+
+
+  public:
+    using Device::CreateResource;
     const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::BufferDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) override
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) override
     {
       return resources.emplace_back(new VLKResource(name, *this, desc, hint, interops));
     }
     const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::Tex1DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) override
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) override
     {
       return resources.emplace_back(new VLKResource(name, *this, desc, hint, interops));
     }
     const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::Tex2DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) override
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) override
     {
       return resources.emplace_back(new VLKResource(name, *this, desc, hint, interops));
     }
     const std::shared_ptr<Resource>& CreateResource(const std::string& name,
       const Resource::Tex3DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {}) override
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {}) override
     {
       return resources.emplace_back(new VLKResource(name, *this, desc, hint, interops));
     }
@@ -145,11 +256,13 @@ namespace RayGene3D
   public:
     const VkPhysicalDeviceProperties& GetProperties() const { return properties; }
     const VkPhysicalDeviceFeatures& GetFeatures() const { return features; }
+    const VkPhysicalDeviceIDProperties& GetIdentity() const { return identity; }
     //const VkPhysicalDeviceMemoryProperties& GetMemory()  const { return memory; }
 
   public:
     VkCommandPool GetCommandPool() const { return command_pool; } //TODO: Remove
     VkCommandBuffer GetCommadBuffer() const { return command_buffer; }
+    VkCommandPool GetTransferPool() const { return transfer_pool; }
 
 
   //public:
@@ -158,16 +271,64 @@ namespace RayGene3D
   //  void ReleaseMemory(VkDeviceMemory& memory);
 
 
+  public:
+    enum MemoryClass
+    {
+      MEMORY_DEVICE = 0, // GPU only
+      MEMORY_UPLOAD = 1, // written by CPU, read by GPU
+      MEMORY_READBACK = 2, // written by GPU, read by CPU
+      MEMORY_TRANSIENT = 3, // lives within a frame, lazily backed where possible
+      MEMORY_SYSTEM = 4, // read by GPU from host memory, where evicted resources go
+    };
+    static const char* GetClassName(MemoryClass memory_class);
+
   public:
     uint32_t GetMemoryIndex(VkMemoryPropertyFlags flags, uint32_t bits) const;
+    uint32_t GetMemoryIndex(MemoryClass memory_class, uint32_t bits, VkDeviceSize size) const;
+    uint32_t GetMemoryCount() const { return memory.memoryTypeCount; }
+    VkMemoryPropertyFlags GetMemoryFlags(uint32_t index) const { return memory.memoryTypes[index].propertyFlags; }
+    uint32_t GetMemoryHeap(uint32_t index) const { return memory.memoryTypes[index].heapIndex; }
+    VkDeviceSize GetHeapUsage(uint32_t heap) const { return heap_usage[heap]; }
+    VkDeviceSize GetHeapBudget(uint32_t heap) const;
+    void UpdateBudget();
+
+  public:
+    std::string Report(uint32_t top = 10);
+    void Snapshot(const std::string& path, uint32_t top = 10);
+    void SetSnapshot(const std::string& path, uint32_t period) { snapshot_path = path; snapshot_period = period; }
+
+  public:
+    uint64_t GetFrame() const { return frame; }
+    void SetResidencyAge(uint32_t residency_age) { this->residency_age = residency_age; }
+    uint32_t GetResidencyAge() const { return residency_age; }
+    uint64_t GetEvictedBytes() const { return evicted_bytes; }
+    uint64_t GetRestoredBytes() const { return restored_bytes; }
+    uint32_t GetEvictedCount() const { return evicted_count; }
+    uint32_t GetRestoredCount() const { return restored_count; }
+    bool Evict(uint32_t heap, VkDeviceSize size);
+
+  protected:
+    void UpdateResidency();
+    void Patch();
+
+  public:
     VkDeviceAddress GetAddress(VkBuffer buffer) const;
-    VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBufferCreateFlags flags = 0) const;
+    VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBufferCreateFlags flags = 0, bool external = false) const;
     VkImage CreateImage(VkImageType type, VkFormat format, VkExtent3D extent, 
       uint32_t mipmaps, uint32_t layers, VkImageUsageFlags usage, VkImageCreateFlags flags = 0) const;
     VkMemoryRequirements GetRequirements(VkBuffer buffer) const;
     VkMemoryRequirements GetRequirements(VkImage image) const;
     VkDeviceMemory AllocateMemory(VkDeviceSize size, uint32_t index,
-      bool addressable = false) const;
+      bool addressable = false, Category category = CATEGORY_BUFFER, const std::string& owner = "");
+    VkDeviceMemory ImportMemory(const void* data, VkDeviceSize size, uint32_t bits,
+      Category category = CATEGORY_BUFFER, const std::string& owner = "");
+    void FreeMemory(VkDeviceMemory memory);
+    void InvalidateMemory(VkDeviceMemory memory) const;
+
+  public:
+    bool GetHostImportSupported() const { return host_import_supported; }
+    VkDeviceSize GetHostImportAlignment() const { return host_import_alignment; }
+    bool GetHostImportable(const void* data, VkDeviceSize size) const;
 
   //public:
   //  void* MapMemory(VkDeviceMemory memory) const;
@@ -177,13 +338,59 @@ namespace RayGene3D
     //void DestroyCommand(const VkCommandBuffer& command);
 
   public:
+    uint64_t Submit(VkQueue queue, VkCommandBuffer command_buffer, uint64_t after = 0,
+      VkSemaphore wait = nullptr, VkSemaphore signal = nullptr);
+    uint64_t GetPoint() const { return point; }
+    bool IsComplete(uint64_t point);
+    void Wait(uint64_t point);
+    void OnComplete(uint64_t point, std::function<void()> callback);
+    void Collect();
+    void Retire(std::shared_ptr<void> object) override;
+
+  public:
+    bool GetSparseSupported() const { return sparse_supported; }
+    bool GetSparse3DSupported() const { return sparse_3d_supported; }
+    void SetSparse(bool sparse) { this->sparse = sparse; }
+    bool GetSparse() const { return sparse; }
+    VkDeviceSize GetPageSize() const { return page_size; }
+    std::pair<VkDeviceMemory, VkDeviceSize> AllocatePage(uint32_t bits);
+    void FreePage(VkDeviceMemory memory, VkDeviceSize offset);
+    uint64_t BindSparse(VkBindSparseInfo bind_info);
+
+  public:
+    VkPhysicalDevice GetAdapter() const { return adapter; }
     VkDevice GetDevice() const { return device; }
     uint32_t GetFamily() const { return family; }
     VkQueue GetQueue() const { return queue; }
+    uint32_t GetComputeFamily() const { return compute_family; }
+    VkQueue GetComputeQueue() const { return compute_queue; }
+    uint32_t GetTransferFamily() const { return transfer_family; }
+    VkQueue GetTransferQueue() const { return transfer_queue; }
 
   public:
     bool GetRayTracingSupported() const { return ray_tracing_supported; }
     const VkPhysicalDeviceRayTracingPipelinePropertiesKHR& GetTracingProperties() const { return  ray_tracing_properties; }
+    const VkPhysicalDeviceAccelerationStructurePropertiesKHR& GetAccelerationProperties() const { return  acceleration_properties; }
+
+  public:
+    bool GetHostBuildSupported() const { return host_build_supported; }
+    void SetHostBuild(bool host_build) { this->host_build = host_build; }
+    bool GetHostBuild() const { return host_build; }
+    void SetGeometryBudget(uint32_t geometry_budget) { this->geometry_budget = geometry_budget; }
+    uint32_t GetGeometryBudget() const { return geometry_budget; }
+    void SetDispatcher(std::function<void(const std::function<void()>&, uint32_t)> dispatcher) { this->dispatcher = dispatcher; }
+    void Dispatch(const std::function<void()>& task, uint32_t count) const;
+    VkResult Defer(const std::function<VkResult(VkDeferredOperationKHR)>& command) const;
+
+  protected:
+    PFN_vkCreateDeferredOperationKHR vkCreateDeferredOperationKHR{ nullptr };
+    PFN_vkDestroyDeferredOperationKHR vkDestroyDeferredOperationKHR{ nullptr };
+    PFN_vkGetDeferredOperationMaxConcurrencyKHR vkGetDeferredOperationMaxConcurrencyKHR{ nullptr };
+    PFN_vkGetDeferredOperationResultKHR vkGetDeferredOperationResultKHR{ nullptr };
+    PFN_vkDeferredOperationJoinKHR vkDeferredOperationJoinKHR{ nullptr };
+
+  protected:
+    PFN_vkGetMemoryHostPointerPropertiesEXT vkGetMemoryHostPointerPropertiesEXT{ nullptr };
 
   public:
     bool GetMeshShaderSupported() const { return mesh_shader_supported; }
@@ -208,6 +415,13 @@ namespace RayGene3D
     void DestroyStaging();
     void CreateScratch();
     void DestroyScratch();
+    void CreateRing();
+    void DestroyRing();
+    void DestroyPages();
+    void DestroyTransient();
+
+  protected:
+    void Compile();
 
   public:
     void Initialize() override;
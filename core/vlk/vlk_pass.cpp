@@ -118,117 +118,191 @@ namespace RayGene3D
   {
     auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
 
-    if (type == TYPE_GRAPHIC)
+    // Merged passes are recorded into the render pass of their leader
+    if (type == TYPE_GRAPHIC && (leader == nullptr || leader == this))
     {
+      const auto members = subpasses.empty() ? std::vector<VLKPass*>{ this } : subpasses;
+
+      attachment_views.clear();
+      attachment_values.clear();
+      attachment_descs.clear();
+      attachment_sources.clear();
+
+      const auto same_fn = [](const std::shared_ptr<View>& lhs, const std::shared_ptr<View>& rhs)
       {
-        std::vector<VkClearValue> rt_attachment_values(rt_attachments.size());
-        std::vector<VkAttachmentDescription> rt_attachment_descs(rt_attachments.size());
-        std::vector<VkImageView> rt_attachment_views(rt_attachments.size());
-        for (size_t i = 0; i < rt_attachments.size(); ++i)
+        return lhs == rhs || (&lhs->GetResource() == &rhs->GetResource()
+          && lhs->GetMipmapsOrCount().offset == rhs->GetMipmapsOrCount().offset && lhs->GetMipmapsOrCount().length == rhs->GetMipmapsOrCount().length
+          && lhs->GetLayersOrStride().offset == rhs->GetLayersOrStride().offset && lhs->GetLayersOrStride().length == rhs->GetLayersOrStride().length);
+      };
+
+      // The first subpass using an attachment decides how it is loaded, any subpass may keep it stored
+      const auto attach_fn = [this, &same_fn](const VLKPass* member, const std::shared_ptr<View>& view, VkImageLayout layout,
+        const VkClearValue& value, VkAttachmentLoadOp load_op)
+      {
+        const auto ops = member->attachment_ops.find(view.get());
+        const auto store_op = ops == member->attachment_ops.end() ? VK_ATTACHMENT_STORE_OP_STORE : ops->second.second;
+
+        for (uint32_t i = 0; i < uint32_t(attachment_sources.size()); ++i)
         {
-          const auto& rt_value = rt_attachments[i].value;
-          const auto& rt_view = rt_attachments[i].view;
-
-          rt_attachment_values[i].color.float32[0] = rt_value ? rt_value.value()[0] : 1.0f;
-          rt_attachment_values[i].color.float32[1] = rt_value ? rt_value.value()[1] : 0.0f;
-          rt_attachment_values[i].color.float32[2] = rt_value ? rt_value.value()[2] : 1.0f;
-          rt_attachment_values[i].color.float32[3] = rt_value ? rt_value.value()[3] : 0.0f;
-
-          rt_attachment_descs[i].format = get_format(rt_view->GetResource().GetFormat());
-          rt_attachment_descs[i].samples = VK_SAMPLE_COUNT_1_BIT;
-          rt_attachment_descs[i].loadOp = rt_value ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-          rt_attachment_descs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-          rt_attachment_descs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-          rt_attachment_descs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-          rt_attachment_descs[i].initialLayout = rt_value ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL;
-          rt_attachment_descs[i].finalLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-          rt_attachment_views[i] = (reinterpret_cast<VLKView*>(rt_view.get()))->GetView();
+          if (!same_fn(attachment_sources[i].first, view)) continue;
+          if (store_op == VK_ATTACHMENT_STORE_OP_STORE) attachment_descs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+          return i;
         }
 
-        std::vector<VkClearValue> ds_attachment_values(ds_attachments.size());
-        std::vector<VkAttachmentDescription> ds_attachment_descs(ds_attachments.size());
-        std::vector<VkImageView> ds_attachment_views(ds_attachments.size());
-        for (size_t i = 0; i < ds_attachments.size(); ++i)
+        VkAttachmentDescription desc = {};
+        desc.format = get_format(view->GetResource().GetFormat());
+        desc.samples = VK_SAMPLE_COUNT_1_BIT;
+        desc.loadOp = ops == member->attachment_ops.end() ? load_op : ops->second.first;
+        desc.storeOp = store_op;
+        desc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+        desc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        desc.initialLayout = layout;
+        desc.finalLayout = layout;
+
+        attachment_descs.push_back(desc);
+        attachment_values.push_back(value);
+        attachment_views.push_back((reinterpret_cast<VLKView*>(view.get()))->GetView());
+        attachment_sources.emplace_back(view, layout);
+        return uint32_t(attachment_sources.size() - 1);
+      };
+
+      std::vector<std::vector<VkAttachmentReference>> rt_attachment_refs(members.size());
+      std::vector<std::vector<VkAttachmentReference>> ds_attachment_refs(members.size());
+      std::vector<std::vector<VkAttachmentReference>> in_attachment_refs(members.size());
+      for (size_t i = 0; i < members.size(); ++i)
+      {
+        const auto member = members[i];
+
+        std::vector<std::shared_ptr<View>> inputs;
+        member->CollectInputs(inputs);
+
+        for (const auto& rt_attachment : member->rt_attachments)
         {
-          const auto& ds_value = ds_attachments[i].value;
-          const auto& ds_view = ds_attachments[i].view;
-
-          ds_attachment_values[i].depthStencil.depth = ds_value.first ? ds_value.first.value() : 0.0f;
-          ds_attachment_values[i].depthStencil.stencil = ds_value.second ? ds_value.second.value() : 0;
-
-          ds_attachment_descs[i].format = get_format(ds_view->GetResource().GetFormat());
-          ds_attachment_descs[i].samples = VK_SAMPLE_COUNT_1_BIT;
-          ds_attachment_descs[i].loadOp = ds_value.first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
-          ds_attachment_descs[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-          ds_attachment_descs[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-          ds_attachment_descs[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-          ds_attachment_descs[i].initialLayout = ds_value.first ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL;
-          ds_attachment_descs[i].finalLayout = VK_IMAGE_LAYOUT_GENERAL;
-
-          ds_attachment_views[i] = (reinterpret_cast<VLKView*>(ds_view.get()))->GetView();
+          const auto& rt_value = rt_attachment.value;
+
+          VkClearValue value = {};
+          value.color.float32[0] = rt_value ? rt_value.value()[0] : 1.0f;
+          value.color.float32[1] = rt_value ? rt_value.value()[1] : 0.0f;
+          value.color.float32[2] = rt_value ? rt_value.value()[2] : 1.0f;
+          value.color.float32[3] = rt_value ? rt_value.value()[3] : 0.0f;
+
+          const auto load_op = rt_value ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+          const auto index = attach_fn(member, rt_attachment.view, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, value, load_op);
+          rt_attachment_refs[i].push_back({ index, member->GetInputLayout(rt_attachment.view) == VK_IMAGE_LAYOUT_GENERAL
+            ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL });
         }
 
-        attachment_values.clear();
-        std::move(rt_attachment_values.begin(), rt_attachment_values.end(), std::back_inserter(attachment_values));
-        std::move(ds_attachment_values.begin(), ds_attachment_values.end(), std::back_inserter(attachment_values));
+        for (const auto& ds_attachment : member->ds_attachments)
+        {
+          const auto& ds_value = ds_attachment.value;
+
+          VkClearValue value = {};
+          value.depthStencil.depth = ds_value.first ? ds_value.first.value() : 0.0f;
+          value.depthStencil.stencil = ds_value.second ? ds_value.second.value() : 0;
 
-        attachment_descs.clear();
-        std::move(rt_attachment_descs.begin(), rt_attachment_descs.end(), std::back_inserter(attachment_descs));
-        std::move(ds_attachment_descs.begin(), ds_attachment_descs.end(), std::back_inserter(attachment_descs));
+          const auto load_op = ds_value.first ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+          const auto index = attach_fn(member, ds_attachment.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, value, load_op);
+          ds_attachment_refs[i].push_back({ index, member->GetInputLayout(ds_attachment.view) == VK_IMAGE_LAYOUT_GENERAL
+            ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL });
+        }
 
-        attachment_views.clear();
-        std::move(rt_attachment_views.begin(), rt_attachment_views.end(), std::back_inserter(attachment_views));
-        std::move(ds_attachment_views.begin(), ds_attachment_views.end(), std::back_inserter(attachment_views));
+        for (const auto& input : inputs)
+        {
+          const auto layout = member->GetInputLayout(input);
+          const auto index = attach_fn(member, input, layout, VkClearValue{}, VK_ATTACHMENT_LOAD_OP_LOAD);
+          in_attachment_refs[i].push_back({ index, layout });
+        }
       }
 
       {
-        std::vector<VkAttachmentReference> rt_attachment_refs(rt_attachments.size());
-        for (size_t i = 0; i < rt_attachments.size(); ++i)
+        // Attachments used before and after a subpass have to survive it
+        std::vector<std::vector<uint32_t>> preserves(members.size());
+        for (uint32_t k = 0; k < uint32_t(attachment_sources.size()); ++k)
         {
-          rt_attachment_refs[i].attachment = uint32_t(i);
-          rt_attachment_refs[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+          const auto used_fn = [k, &rt_attachment_refs, &ds_attachment_refs, &in_attachment_refs](size_t i)
+          {
+            const auto ref_fn = [k](const VkAttachmentReference& ref) { return ref.attachment == k; };
+            return std::any_of(rt_attachment_refs[i].begin(), rt_attachment_refs[i].end(), ref_fn)
+              || std::any_of(ds_attachment_refs[i].begin(), ds_attachment_refs[i].end(), ref_fn)
+              || std::any_of(in_attachment_refs[i].begin(), in_attachment_refs[i].end(), ref_fn);
+          };
+
+          auto first = members.size();
+          auto last = size_t(0);
+          for (size_t i = 0; i < members.size(); ++i)
+          {
+            if (!used_fn(i)) continue;
+            first = std::min(first, i);
+            last = std::max(last, i);
+          }
+          for (size_t i = first + 1; i < last; ++i)
+          {
+            if (!used_fn(i)) preserves[i].push_back(k);
+          }
         }
 
-        std::vector<VkAttachmentReference> ds_attachment_refs(ds_attachments.size());
-        for (size_t i = 0; i < ds_attachments.size(); ++i)
+        std::vector<VkSubpassDescription> descs(members.size());
+        for (size_t i = 0; i < members.size(); ++i)
         {
-          ds_attachment_refs[i].attachment = uint32_t(i + rt_attachment_refs.size());
-          ds_attachment_refs[i].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+          auto& subpass = descs[i];
+          subpass.flags = 0;
+          subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+          subpass.inputAttachmentCount = uint32_t(in_attachment_refs[i].size());
+          subpass.pInputAttachments = in_attachment_refs[i].data();
+          subpass.colorAttachmentCount = uint32_t(rt_attachment_refs[i].size());
+          subpass.pColorAttachments = rt_attachment_refs[i].data();
+          subpass.pResolveAttachments = nullptr;
+          subpass.pDepthStencilAttachment = ds_attachment_refs[i].empty() ? nullptr : &ds_attachment_refs[i].at(0);
+          subpass.preserveAttachmentCount = uint32_t(preserves[i].size());
+          subpass.pPreserveAttachments = preserves[i].data();
         }
 
-        VkSubpassDescription subpass = {};
-        subpass.flags = 0;
-        subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.inputAttachmentCount = 0;
-        subpass.pInputAttachments = nullptr;
-        subpass.colorAttachmentCount = uint32_t(rt_attachment_refs.size());
-        subpass.pColorAttachments = rt_attachment_refs.data();
-        subpass.pResolveAttachments = nullptr;
-        subpass.pDepthStencilAttachment = ds_attachment_refs.empty() ? nullptr : &ds_attachment_refs.at(0);
-        subpass.preserveAttachmentCount = 0;
-        subpass.pPreserveAttachments = nullptr;
-
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        std::vector<VkSubpassDependency> dependencies(members.size());
+        {
+          auto& dependency = dependencies[0];
+          dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+          dependency.dstSubpass = 0;
+          dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+          dependency.srcAccessMask = 0;
+          dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+          dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        }
+        for (uint32_t i = 1; i < uint32_t(members.size()); ++i)
+        {
+          // Attachment writes of a subpass are read by the next one at the same pixel only
+          auto& dependency = dependencies[i];
+          dependency.srcSubpass = i - 1;
+          dependency.dstSubpass = i;
+          dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+          dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+          dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+            | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+          dependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT
+            | VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+            | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+          dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        }
 
         VkRenderPassCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         create_info.attachmentCount = uint32_t(attachment_descs.size());
         create_info.pAttachments = attachment_descs.data();
-        create_info.subpassCount = 1;
-        create_info.pSubpasses = &subpass;
-        create_info.dependencyCount = 1;
-        create_info.pDependencies = &dependency;
+        create_info.subpassCount = uint32_t(descs.size());
+        create_info.pSubpasses = descs.data();
+        create_info.dependencyCount = uint32_t(dependencies.size());
+        create_info.pDependencies = dependencies.data();
         BLAST_ASSERT(VK_SUCCESS == vkCreateRenderPass(device->GetDevice(), &create_info, nullptr, &renderpass));
+
+        if (members.size() > 1)
+        {
+          BLAST_LOG("Merged %d passes into %d attachments render pass [%s]", uint32_t(members.size()), uint32_t(attachment_descs.size()), name.c_str());
+        }
       }
 
 
+      // Transient attachments have no views until placed, the framebuffer is built on compile
+      if (std::find(attachment_views.begin(), attachment_views.end(), VkImageView(nullptr)) == attachment_views.end())
       {
         VkFramebufferCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -243,6 +317,331 @@ namespace RayGene3D
     }
   }
 
+  void VLKPass::SetSubpasses(const std::vector<VLKPass*>& subpasses)
+  {
+    this->subpasses = subpasses;
+    for (uint32_t i = 0; i < uint32_t(subpasses.size()); ++i)
+    {
+      subpasses[i]->leader = this;
+      subpasses[i]->subpass = i;
+    }
+  }
+
+  void VLKPass::CollectInputs(std::vector<std::shared_ptr<View>>& inputs) const
+  {
+    if (type != TYPE_GRAPHIC) return;
+
+    // Input attachment indices follow the order views appear in the batches
+    for (const auto& config : configs)
+    {
+      config->VisitBatch([&inputs](const std::shared_ptr<Batch>& batch)
+      {
+        batch->VisitView([&inputs](const std::shared_ptr<View>& view, Batch::Access access)
+        {
+          if (access == Batch::ACCESS_READ_IMAGE && (view->GetBind() & View::BIND_SUBPASS_INPUT) != 0
+            && std::find(inputs.begin(), inputs.end(), view) == inputs.end())
+          {
+            inputs.push_back(view);
+          }
+          return false;
+        });
+        return false;
+      });
+    }
+  }
+
+  VkImageLayout VLKPass::GetInputLayout(const std::shared_ptr<View>& view) const
+  {
+    const auto resource = reinterpret_cast<VLKResource*>(&view->GetResource());
+
+    // Reading an attachment of the same subpass needs the one layout valid for both
+    std::vector<std::shared_ptr<View>> inputs;
+    CollectInputs(inputs);
+    const auto input = std::any_of(inputs.begin(), inputs.end(),
+      [resource](const std::shared_ptr<View>& item) { return &item->GetResource() == resource; });
+    const auto attached = std::any_of(rt_attachments.begin(), rt_attachments.end(),
+      [resource](const RTAttachment& item) { return &item.view->GetResource() == resource; })
+      || std::any_of(ds_attachments.begin(), ds_attachments.end(),
+      [resource](const DSAttachment& item) { return &item.view->GetResource() == resource; });
+    if (input && attached) return VK_IMAGE_LAYOUT_GENERAL;
+
+    return resource->GetAspect() & VK_IMAGE_ASPECT_COLOR_BIT ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+  }
+
+  bool VLKPass::CanMerge(const std::vector<VLKPass*>& group) const
+  {
+    if (type != TYPE_GRAPHIC || group.empty()) return false;
+
+    const auto head = group.front();
+    if (head->type != TYPE_GRAPHIC || head->size_x != size_x || head->size_y != size_y || head->layers != layers) return false;
+
+    std::vector<std::shared_ptr<View>> inputs;
+    CollectInputs(inputs);
+    if (inputs.empty()) return false;
+
+    // Attachments the group renders to, and everything it touches in any other way
+    std::set<const Resource*> attached;
+    std::set<const Resource*> touched;
+    std::set<const Resource*> written;
+    for (const auto member : group)
+    {
+      std::vector<std::shared_ptr<View>> member_inputs;
+      member->CollectInputs(member_inputs);
+
+      for (const auto& rt_attachment : member->rt_attachments) attached.insert(&rt_attachment.view->GetResource());
+      for (const auto& ds_attachment : member->ds_attachments) attached.insert(&ds_attachment.view->GetResource());
+      for (const auto& config : member->configs)
+      {
+        config->VisitBatch([&touched, &written, &member_inputs](const std::shared_ptr<Batch>& batch)
+        {
+          batch->VisitView([&touched, &written, &member_inputs](const std::shared_ptr<View>& view, Batch::Access access)
+          {
+            if (std::find(member_inputs.begin(), member_inputs.end(), view) != member_inputs.end()) return false;
+            touched.insert(&view->GetResource());
+            if (access == Batch::ACCESS_WRITE_IMAGE || access == Batch::ACCESS_WRITE_BUFFER) written.insert(&view->GetResource());
+            return false;
+          });
+          return false;
+        });
+      }
+    }
+
+    // Inputs have to come from the group, which must not be read or written outside of attachments
+    for (const auto& input : inputs)
+    {
+      if (attached.count(&input->GetResource()) == 0) return false;
+    }
+    for (const auto& rt_attachment : rt_attachments)
+    {
+      if (touched.count(&rt_attachment.view->GetResource()) > 0) return false;
+    }
+    for (const auto& ds_attachment : ds_attachments)
+    {
+      if (touched.count(&ds_attachment.view->GetResource()) > 0) return false;
+    }
+
+    auto mergeable = true;
+    for (const auto& config : configs)
+    {
+      config->VisitBatch([&mergeable, &inputs, &attached, &touched, &written](const std::shared_ptr<Batch>& batch)
+      {
+        batch->VisitView([&mergeable, &inputs, &attached, &touched, &written](const std::shared_ptr<View>& view, Batch::Access access)
+        {
+          if (std::find(inputs.begin(), inputs.end(), view) != inputs.end()) return false;
+
+          const auto resource = &view->GetResource();
+          const auto write = access == Batch::ACCESS_WRITE_IMAGE || access == Batch::ACCESS_WRITE_BUFFER;
+          mergeable = attached.count(resource) == 0 && written.count(resource) == 0 && (!write || touched.count(resource) == 0);
+          return !mergeable;
+        });
+        return !mergeable;
+      });
+    }
+    return mergeable;
+  }
+
+  void VLKPass::Infer(const std::function<bool(const Resource*)>& loaded, const std::function<bool(const Resource*)>& stored)
+  {
+    attachment_ops.clear();
+
+    const auto infer_fn = [this, &loaded, &stored](const std::shared_ptr<View>& view, bool cleared)
+    {
+      const auto resource = &view->GetResource();
+      const auto load_op = cleared ? VK_ATTACHMENT_LOAD_OP_CLEAR : loaded(resource) ? VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+      const auto store_op = stored(resource) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+      attachment_ops.emplace(view.get(), std::make_pair(load_op, store_op));
+    };
+
+    for (const auto& rt_attachment : rt_attachments) infer_fn(rt_attachment.view, bool(rt_attachment.value));
+    for (const auto& ds_attachment : ds_attachments) infer_fn(ds_attachment.view, bool(ds_attachment.value.first));
+
+    std::vector<std::shared_ptr<View>> inputs;
+    CollectInputs(inputs);
+    for (const auto& input : inputs) infer_fn(input, false);
+  }
+
+  void VLKPass::Synchronize(VkCommandBuffer command_buffer)
+  {
+    auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    const auto shader_stages = 
+      type == TYPE_GRAPHIC ? VkPipelineStageFlags(VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+        | (device->GetMeshShaderSupported() ? VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_MESH_SHADER_BIT_EXT : 0)) :
+      type == TYPE_COMPUTE ? VkPipelineStageFlags(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT) :
+      type == TYPE_TRACING ? VkPipelineStageFlags(VK_PIPELINE_STAGE_RAY_TRACING_SHADER_BIT_KHR) :
+      VkPipelineStageFlags(0);
+
+    // Accesses are merged per resource first, hazards inside one pass are left to the pass itself
+    struct Access
+    {
+      VkPipelineStageFlags stages{ 0 };
+      VkAccessFlags accesses{ 0 };
+      bool write{ false };
+    };
+    std::map<VLKResource*, Access> accesses;
+
+    const auto access_fn = [&accesses](const std::shared_ptr<View>& view, VkPipelineStageFlags stages, VkAccessFlags flags, bool write)
+    {
+      auto& access = accesses[reinterpret_cast<VLKResource*>(&view->GetResource())];
+      access.stages |= stages;
+      access.accesses |= flags;
+      access.write |= write;
+    };
+
+    // Image layouts are requested per view, attachments not loaded do not need their previous contents
+    struct Layout
+    {
+      std::shared_ptr<View> view;
+      VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+      bool discard{ false };
+      VkPipelineStageFlags stages{ 0 };
+      VkAccessFlags accesses{ 0 };
+    };
+    std::vector<Layout> layouts;
+
+    const auto layout_fn = [&layouts](const std::shared_ptr<View>& view, VkImageLayout layout, bool discard, VkPipelineStageFlags stages, VkAccessFlags flags)
+    {
+      layouts.push_back({ view, layout, discard, stages, flags });
+    };
+
+    for (uint32_t i = 0; i < uint32_t(attachment_sources.size()); ++i)
+    {
+      const auto& [view, layout] = attachment_sources[i];
+      const auto discard = attachment_descs[i].loadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+      switch (layout)
+      {
+      case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: layout_fn(view, layout, discard, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT); break;
+      case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: layout_fn(view, layout, discard, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT); break;
+      default: layout_fn(view, layout, discard, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT); break;
+      }
+    }
+
+    const auto members = subpasses.empty() ? std::vector<VLKPass*>{ this } : subpasses;
+    for (const auto member : members)
+    {
+      std::vector<std::shared_ptr<View>> inputs;
+      member->CollectInputs(inputs);
+
+      for (const auto& rt_attachment : member->rt_attachments)
+      {
+        access_fn(rt_attachment.view, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+          VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true);
+      }
+
+      for (const auto& ds_attachment : member->ds_attachments)
+      {
+        access_fn(ds_attachment.view, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+          VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true);
+      }
+
+      for (const auto& input : inputs)
+      {
+        access_fn(input, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, false);
+      }
+
+      for (const auto& config : member->configs)
+      {
+        config->VisitBatch([&access_fn, &layout_fn, &inputs, shader_stages](const std::shared_ptr<Batch>& batch)
+        {
+          batch->VisitView([&access_fn, &layout_fn, &inputs, shader_stages](const std::shared_ptr<View>& view, Batch::Access access)
+          {
+            // Input attachments are laid out and synchronized by the render pass
+            if (std::find(inputs.begin(), inputs.end(), view) != inputs.end()) return false;
+
+            const auto resource = reinterpret_cast<VLKResource*>(&view->GetResource());
+            switch (access)
+            {
+            case Batch::ACCESS_READ_IMAGE: layout_fn(view, resource->GetShaderLayout(), false, shader_stages, VK_ACCESS_SHADER_READ_BIT); break;
+            case Batch::ACCESS_WRITE_IMAGE: layout_fn(view, VK_IMAGE_LAYOUT_GENERAL, false, shader_stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT); break;
+            default: break;
+            }
+
+            switch (access)
+            {
+            case Batch::ACCESS_VERTEX_ARRAY: access_fn(view, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, false); break;
+            case Batch::ACCESS_INDEX_ARRAY: access_fn(view, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, false); break;
+            case Batch::ACCESS_ARGUMENT: access_fn(view, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, false); break;
+            case Batch::ACCESS_UNIFORM_BUFFER:
+            case Batch::ACCESS_SHIFTED_BUFFER: access_fn(view, shader_stages, VK_ACCESS_UNIFORM_READ_BIT, false); break;
+            case Batch::ACCESS_READ_IMAGE:
+            case Batch::ACCESS_READ_BUFFER: access_fn(view, shader_stages, VK_ACCESS_SHADER_READ_BIT, false); break;
+            case Batch::ACCESS_WRITE_IMAGE:
+            case Batch::ACCESS_WRITE_BUFFER: access_fn(view, shader_stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true); break;
+            default: break;
+            }
+            return false;
+          });
+          return false;
+        });
+      }
+    }
+
+    VkPipelineStageFlags src_stages{ 0 };
+    VkAccessFlags src_accesses{ 0 };
+    VkPipelineStageFlags dst_stages{ 0 };
+    VkAccessFlags dst_accesses{ 0 };
+
+    for (const auto member : members)
+    {
+      for (const auto& acquire : member->acquires)
+      {
+        acquire->Acquire(src_stages, src_accesses);
+      }
+    }
+
+    // Transitions are resolved against the state before this pass, so they go ahead of tracking
+    std::vector<VkImageMemoryBarrier> barriers;
+    for (const auto& layout : layouts)
+    {
+      const auto resource = reinterpret_cast<VLKResource*>(&layout.view->GetResource());
+      resource->Transition(layout.view->GetMipmapsOrCount(), layout.view->GetLayersOrStride(), layout.layout, layout.discard,
+        layout.stages, layout.accesses, src_stages, dst_stages, barriers);
+    }
+
+    for (const auto& access : accesses)
+    {
+      access.first->Track(access.second.stages, access.second.accesses, access.second.write,
+        src_stages, src_accesses, dst_stages, dst_accesses);
+    }
+
+    // Work of the graphics queue is awaited through semaphores, the compute queue only keeps its own stages
+    if (async && type == TYPE_COMPUTE && device->GetComputeQueue() != device->GetQueue())
+    {
+      const auto stage_mask = VkPipelineStageFlags(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+        | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+      const auto access_mask = VkAccessFlags(VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT
+        | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+      src_stages &= stage_mask;
+      dst_stages &= stage_mask;
+      src_accesses &= access_mask;
+      dst_accesses &= access_mask;
+      for (auto& barrier : barriers)
+      {
+        barrier.srcAccessMask &= access_mask;
+        barrier.dstAccessMask &= access_mask;
+      }
+      if (src_stages == 0 && !barriers.empty()) src_stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+
+    // Independent passes get no barrier at all, dependent ones one merged barrier
+    if (src_stages == 0) return;
+
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = src_accesses;
+    barrier.dstAccessMask = dst_accesses;
+
+    vkCmdPipelineBarrier(command_buffer,
+      src_stages, dst_stages,
+      0,
+      src_accesses != 0 || dst_accesses != 0 ? 1 : 0, &barrier,
+      0, nullptr,
+      uint32_t(barriers.size()), barriers.data());
+  }
+
   void VLKPass::Use()
   {
     if (!enabled) return;
@@ -251,25 +650,43 @@ namespace RayGene3D
 
     const auto command_buffer = device->GetCommadBuffer();
 
-    if (type == TYPE_GRAPHIC)
+    // Merged passes continue the render pass of their leader
+    const auto follower = leader != nullptr && leader != this;
+    if (!follower)
     {
-      auto pass_info = VkRenderPassBeginInfo{};
-      pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-      pass_info.renderPass = renderpass;
-      pass_info.framebuffer = framebuffer;
-      pass_info.renderArea.offset = { 0, 0 };
-      pass_info.renderArea.extent = { size_x, size_y };
-      pass_info.clearValueCount = uint32_t(attachment_values.size());
-      pass_info.pClearValues = attachment_values.data();
+      Synchronize(command_buffer);
+    }
 
-      vkCmdBeginRenderPass(command_buffer, &pass_info, VK_SUBPASS_CONTENTS_INLINE);
+    if (type == TYPE_GRAPHIC)
+    {
+      if (follower)
+      {
+        vkCmdNextSubpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+      }
+      else
+      {
+        auto pass_info = VkRenderPassBeginInfo{};
+        pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        pass_info.renderPass = renderpass;
+        pass_info.framebuffer = framebuffer;
+        pass_info.renderArea.offset = { 0, 0 };
+        pass_info.renderArea.extent = { size_x, size_y };
+        pass_info.clearValueCount = uint32_t(attachment_values.size());
+        pass_info.pClearValues = attachment_values.data();
+
+        vkCmdBeginRenderPass(command_buffer, &pass_info, VK_SUBPASS_CONTENTS_INLINE);
+      }
 
       for (const auto& config : configs)
       {
         config->Use();
       }
 
-      vkCmdEndRenderPass(command_buffer);
+      const auto& group = (follower ? leader : this)->subpasses;
+      if (group.empty() || group.back() == this)
+      {
+        vkCmdEndRenderPass(command_buffer);
+      }
     }
 
     if (type == TYPE_COMPUTE)
@@ -287,18 +704,6 @@ namespace RayGene3D
         config->Use();
       }
     }
-
-    VkMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
-    barrier.dstAccessMask = 0;
-
-    vkCmdPipelineBarrier(command_buffer,
-      VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-      0,
-      1, &barrier,
-      0, nullptr,
-      0, nullptr);
   }
 
   void VLKPass::Discard()
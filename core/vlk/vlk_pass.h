@@ -43,6 +43,8 @@ THE SOFTWARE.
 
 namespace RayGene3D
 {
+  class VLKResource;
+
   class VLKPass : public Pass
   {
   protected:
@@ -52,13 +54,30 @@ namespace RayGene3D
     std::vector<VkImageView> attachment_views;
     std::vector<VkClearValue> attachment_values;
     std::vector<VkAttachmentDescription> attachment_descs;
+    std::vector<std::pair<std::shared_ptr<View>, VkImageLayout>> attachment_sources; // layout around the render pass
 
     VkFramebuffer framebuffer{ nullptr };
     VkRenderPass renderpass{ nullptr };
 
+    std::vector<VLKResource*> acquires; // transient resources starting their lifetime here
+    std::map<const View*, std::pair<VkAttachmentLoadOp, VkAttachmentStoreOp>> attachment_ops; // inferred from the schedule
+
+    VLKPass* leader{ nullptr }; // owner of the merged render pass
+    std::vector<VLKPass*> subpasses; // merged passes, leader first
+    uint32_t subpass{ 0 };
+
   public:
     VkCommandBuffer GetCommandBuffer() const { return command_buffer; }
-    VkRenderPass GetRenderPass() const { return renderpass; }
+    VkRenderPass GetRenderPass() const { return leader ? leader->renderpass : renderpass; }
+    uint32_t GetSubpass() const { return subpass; }
+    void SetAcquires(const std::vector<VLKResource*>& acquires) { this->acquires = acquires; }
+    void SetSubpasses(const std::vector<VLKPass*>& subpasses);
+    void Infer(const std::function<bool(const Resource*)>& loaded, const std::function<bool(const Resource*)>& stored);
+
+  public:
+    void CollectInputs(std::vector<std::shared_ptr<View>>& inputs) const;
+    VkImageLayout GetInputLayout(const std::shared_ptr<View>& view) const;
+    bool CanMerge(const std::vector<VLKPass*>& group) const;
 
   public:
     const std::shared_ptr<Config>& CreateConfig(const std::string& name,
@@ -73,6 +92,9 @@ namespace RayGene3D
       return configs.emplace_back(new VLKConfig(name, *this, source, compilation, defines, ia_state, rc_state, ds_state, om_state));
     }
 
+  protected:
+    void Synchronize(VkCommandBuffer command_buffer);
+
   public:
     void Initialize() override;
     void Use() override;
@@ -30,17 +30,21 @@ THE SOFTWARE.
 #include "vlk_resource.h"
 #include "vlk_device.h"
 
+#include <numeric>
+
 namespace RayGene3D
 {
   void VLKResource::Initialize()
   {
     const auto& device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
 
-    const auto get_flags = [this]()
+    const auto get_class = [this]()
     {
-      uint32_t flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-      flags = hint & HINT_DYNAMIC_BUFFER ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT : flags;
-      return flags;
+      auto memory_class = VLKDevice::MEMORY_DEVICE;
+      memory_class = hint & HINT_DYNAMIC_BUFFER ? VLKDevice::MEMORY_UPLOAD : memory_class;
+      memory_class = hint & HINT_READBACK_BUFFER ? VLKDevice::MEMORY_READBACK : memory_class;
+      memory_class = lazy ? VLKDevice::MEMORY_TRANSIENT : memory_class;
+      return memory_class;
     };
 
     switch (type)
@@ -57,26 +61,91 @@ namespace RayGene3D
         bind = usage & USAGE_CONSTANT_DATA       ? bind | (VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) : bind;
         bind = usage & USAGE_ARGUMENT_LIST  ? bind | (VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT) : bind;
         bind = usage & USAGE_RAYTRACING_INPUT   ? bind | (VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR) : bind;
+        bind = hint & HINT_READBACK_BUFFER      ? bind | VK_BUFFER_USAGE_TRANSFER_DST_BIT : bind;
 
         return bind;
       };
 
+      // Sparse buffers are bound page by page on commit, devices without sparse support back them at once
+      if ((hint & HINT_SPARSE_RESOURCE) && device->GetSparseSupported())
+      {
+        BLAST_ASSERT(interops.empty());
+        const auto size = VkDeviceSize(mipmaps_or_count) * layers_or_stride;
+        const auto usage = get_bind() | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        const auto flags = VK_BUFFER_CREATE_SPARSE_BINDING_BIT | VK_BUFFER_CREATE_SPARSE_RESIDENCY_BIT;
+        const auto buffer = device->CreateBuffer(size, usage, flags);
+        const auto requirements = device->GetRequirements(buffer);
+
+        if (device->GetPageSize() % requirements.alignment == 0)
+        {
+          this->buffer = buffer;
+          this->buffer_usage = usage;
+          this->sparse = true;
+          this->page_bits = requirements.memoryTypeBits;
+        }
+        else
+        {
+          vkDestroyBuffer(device->GetDevice(), buffer, nullptr);
+        }
+      }
+      this->page_size = device->GetPageSize();
+
+      // Host allocations the caller keeps alive may become the buffer memory itself
+      if (!sparse && (hint & HINT_EXTERNAL_BUFFER) && !(hint & (HINT_ADDRESS_BUFFER | HINT_MAPPED_RESOURCE)) && interops.size() == 1)
+      {
+        const auto [interop_data, interop_size] = interops[0];
+        const auto size = VkDeviceSize(mipmaps_or_count) * layers_or_stride;
+        const auto usage = get_bind() | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        const auto buffer = device->CreateBuffer(size, usage, 0, true);
+        const auto requirements = device->GetRequirements(buffer);
+        const auto memory = requirements.size <= interop_size
+          ? device->ImportMemory(interop_data, interop_size, requirements.memoryTypeBits, VLKDevice::CATEGORY_BUFFER, name) : nullptr;
+
+        if (memory)
+        {
+          BLAST_LOG("Importing %llu bytes of host memory [%s]", static_cast<unsigned long long>(interop_size), name.c_str());
+          BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+          if (hint & (HINT_DYNAMIC_BUFFER | HINT_READBACK_BUFFER))
+          {
+            BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+          }
+
+          this->buffer = buffer;
+          this->memory = memory;
+          this->buffer_usage = usage;
+          this->external = true;
+        }
+        else
+        {
+          vkDestroyBuffer(device->GetDevice(), buffer, nullptr);
+        }
+      }
+
+      if (!sparse && !external)
       {
         const auto addressable = hint & HINT_ADDRESS_BUFFER && device->GetRayTracingSupported();
-        const auto size = mipmaps_or_count * layers_or_stride;
-        const auto usage = get_bind() | (addressable ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0);
+        const auto size = VkDeviceSize(mipmaps_or_count) * layers_or_stride;
+        const auto usage = get_bind() | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | (addressable ? VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT : 0);
         const auto buffer = device->CreateBuffer(size, usage);
         const auto requirements = device->GetRequirements(buffer);
-        const auto flags = get_flags();
-        const auto index = device->GetMemoryIndex(flags, requirements.memoryTypeBits);
+        const auto memory_class = get_class();
+        const auto index = device->GetMemoryIndex(memory_class, requirements.memoryTypeBits, requirements.size);
         
-        BLAST_LOG("Allocating %d bytes [%s]", requirements.size, name.c_str());
-        const auto memory = device->AllocateMemory(requirements.size, index, addressable);
+        BLAST_LOG("Allocating %llu bytes as %s from type %d heap %d [%s]", static_cast<unsigned long long>(requirements.size),
+          VLKDevice::GetClassName(memory_class), index, device->GetMemoryHeap(index), name.c_str());
+        const auto memory = device->AllocateMemory(requirements.size, index, addressable, VLKDevice::CATEGORY_BUFFER, name);
 
         BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
 
+        if (hint & (HINT_DYNAMIC_BUFFER | HINT_READBACK_BUFFER))
+        {
+          BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+        }
+
         this->buffer = buffer;
         this->memory = memory;
+        this->buffer_usage = usage;
       }
 
       //auto create_info = VkBufferCreateInfo{};
@@ -107,9 +176,9 @@ namespace RayGene3D
 
       //BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
 
-      if (!interops.empty())
+      if (!interops.empty() && !external && ((hint & HINT_MAPPED_RESOURCE) || !ImportInterops()))
       {
-        auto size = 0u;
+        auto size = VkDeviceSize{ 0 };
         for (uint32_t i = 0; i < uint32_t(interops.size()); ++i)
         {
           const auto [interop_data, interop_size] = interops[i];
@@ -118,12 +187,12 @@ namespace RayGene3D
           size += interop_size;
         }
 
-        BLAST_ASSERT(size == mipmaps_or_count * layers_or_stride);
+        BLAST_ASSERT(size == VkDeviceSize(mipmaps_or_count) * layers_or_stride);
 
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = device->GetCommandPool();
+        allocInfo.commandPool = device->GetTransferPool();
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer;
@@ -134,13 +203,13 @@ namespace RayGene3D
         VkDeviceMemory staging_memory = device->GetStagingMemory();
 
         const auto src_count = uint32_t(interops.size());
-        const auto dst_count = (size - 1) / uint32_t(staging_size) + 1;
+        const auto dst_count = (size - 1) / staging_size + 1;
 
-        auto dst_index = 0u;
+        auto dst_index = VkDeviceSize{ 0 };
         auto src_index = 0u;
 
-        auto dst_offset = 0u;
-        auto src_offset = 0u;
+        auto dst_offset = VkDeviceSize{ 0 };
+        auto src_offset = VkDeviceSize{ 0 };
 
         while (dst_index < dst_count)
         {
@@ -148,7 +217,7 @@ namespace RayGene3D
           BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
 
           const auto dst_data = reinterpret_cast<uint8_t*>(mapped);
-          const auto dst_size = uint32_t(staging_size);
+          const auto dst_size = staging_size;
 
           while(src_index < src_count)
           {
@@ -186,18 +255,12 @@ namespace RayGene3D
 
           BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(commandBuffer));
 
-          VkSubmitInfo submitInfo{};
-          submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-          submitInfo.commandBufferCount = 1;
-          submitInfo.pCommandBuffers = &commandBuffer;
-
-          BLAST_ASSERT(VK_SUCCESS == vkQueueSubmit(device->GetQueue(), 1, &submitInfo, VK_NULL_HANDLE));
-          BLAST_ASSERT(VK_SUCCESS == vkQueueWaitIdle(device->GetQueue()));
+          device->Wait(device->Submit(device->GetTransferQueue(), commandBuffer));
 
           if (dst_offset == dst_size) { dst_offset = 0; dst_index += 1; }
           if (src_index == src_count) break;
         }
-        vkFreeCommandBuffers(device->GetDevice(), device->GetCommandPool(), 1, &commandBuffer);
+        vkFreeCommandBuffers(device->GetDevice(), device->GetTransferPool(), 1, &commandBuffer);
       }
 
       //if(interops.size() == 1) // TODO: Implement combining multiple properties
@@ -269,6 +332,7 @@ namespace RayGene3D
         bind = usage & USAGE_UNORDERED_ACCESS   ? bind | (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_STORAGE_BIT) : bind;
         bind = usage & USAGE_RENDER_TARGET  ? bind | (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) : bind;
         bind = usage & USAGE_DEPTH_STENCIL  ? bind | (VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) : bind;
+        bind = usage & USAGE_SHADER_RESOURCE && usage & (USAGE_RENDER_TARGET | USAGE_DEPTH_STENCIL) ? bind | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : bind;
         return bind;
       };
 
@@ -375,24 +439,75 @@ namespace RayGene3D
 
       {
         
+        // Streaming images start out with the mipmap tail only
+        const auto streaming = (hint & HINT_STREAMING_IMAGE) != 0;
+        BLAST_ASSERT(!streaming || (interops.size() == layers_or_stride * mipmaps_or_count && (usage & ~USAGE_SHADER_RESOURCE) == 0));
+        this->resident = streaming ? GetTail() : 0;
+
         const auto type = get_type();
         const auto format = get_format();
-        const auto extent = get_extent();
-        const auto mipmap = mipmaps_or_count;
+        const auto full_extent = get_extent();
+        const auto extent = VkExtent3D{ std::max(1u, full_extent.width >> resident),
+          std::max(1u, full_extent.height >> resident), std::max(1u, full_extent.depth >> resident) };
+        const auto mipmap = mipmaps_or_count - resident;
         const auto layers = layers_or_stride;
-        const auto usage = get_bind();
-        const auto flags = get_flags();
-        const auto image = device->CreateImage(type, format, extent, mipmap, layers, usage, flags);
-        const auto requirements = device->GetRequirements(image);
-        const auto property = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        const auto index = device->GetMemoryIndex(property, requirements.memoryTypeBits);
-        BLAST_LOG("Allocating %d bytes [%s]", requirements.size, name.c_str());
-        const auto memory = device->AllocateMemory(requirements.size, index, false);
+        const auto attachment = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        const auto usage = lazy ? (get_bind() & attachment) | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : get_bind();
 
-        BLAST_ASSERT(VK_SUCCESS == vkBindImageMemory(device->GetDevice(), image, memory, 0));
+        // Sparse images are only created where the format supports sparse residency, volumes need a feature of their own
+        auto sparse = (hint & HINT_SPARSE_RESOURCE) && !(hint & HINT_TRANSIENT_IMAGE) && device->GetSparseSupported() && !lazy && !streaming
+          && (type != VK_IMAGE_TYPE_3D || device->GetSparse3DSupported());
+        if (sparse)
+        {
+          BLAST_ASSERT(interops.empty());
+          auto sparse_count = uint32_t{ 0 };
+          vkGetPhysicalDeviceSparseImageFormatProperties(device->GetAdapter(), format, type,
+            VK_SAMPLE_COUNT_1_BIT, usage, VK_IMAGE_TILING_OPTIMAL, &sparse_count, nullptr);
+          sparse = sparse_count > 0;
+        }
 
+        const auto flags = get_flags() | (sparse ? VK_IMAGE_CREATE_SPARSE_BINDING_BIT | VK_IMAGE_CREATE_SPARSE_RESIDENCY_BIT : 0);
+        auto image = device->CreateImage(type, format, extent, mipmap, layers, usage, flags);
         this->image = image;
-        this->memory = memory;
+        this->layouts.assign(layers_or_stride * mipmaps_or_count, VK_IMAGE_LAYOUT_UNDEFINED);
+        this->image_type = type;
+        this->image_format = format;
+        this->image_usage = usage;
+        this->image_flags = flags;
+        this->page_size = device->GetPageSize();
+        this->tile_extent = { 128, 128, 1 };
+        this->tail_first = mipmaps_or_count;
+
+        if (sparse && !BindTail())
+        {
+          vkDestroyImage(device->GetDevice(), image, nullptr);
+          image = device->CreateImage(type, format, extent, mipmap, layers, usage, get_flags());
+          this->image = image;
+          this->image_flags = get_flags();
+        }
+
+        // Transient images are placed into the shared heap once the schedule is compiled
+        if ((hint & HINT_TRANSIENT_IMAGE) && !lazy)
+        {
+          BLAST_ASSERT(interops.empty());
+          pending = true;
+          return;
+        }
+
+        if (!this->sparse)
+        {
+          // Attachments that never leave the tile may have no backing at all
+          const auto requirements = device->GetRequirements(image);
+          const auto memory_class = get_class();
+          const auto index = device->GetMemoryIndex(memory_class, requirements.memoryTypeBits, requirements.size);
+          BLAST_LOG("Allocating %llu bytes as %s from type %d heap %d [%s]", static_cast<unsigned long long>(requirements.size),
+            VLKDevice::GetClassName(memory_class), index, device->GetMemoryHeap(index), name.c_str());
+          const auto memory = device->AllocateMemory(requirements.size, index, false, VLKDevice::CATEGORY_IMAGE, name);
+
+          BLAST_ASSERT(VK_SUCCESS == vkBindImageMemory(device->GetDevice(), image, memory, 0));
+
+          this->memory = memory;
+        }
       }
 
       VkBuffer staging_buffer = device->GetStagingBuffer();
@@ -401,107 +516,158 @@ namespace RayGene3D
 
       if (interops.size() == layers_or_stride * mipmaps_or_count)
       {
+        struct Piece
+        {
+          const uint8_t* data{ nullptr };
+          VkDeviceSize size{ 0 };
+          VkDeviceSize alignment{ 0 };
+          VkBufferImageCopy region{};
+        };
+        std::vector<Piece> pieces;
+
+        // Subresources larger than the staging buffer go in slabs of whole slices or rows, block rows when compressed
+        const auto block = image_format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && image_format <= VK_FORMAT_BC7_SRGB_BLOCK ? 4u : 1u;
+        for (uint32_t i = 0; i < layers_or_stride; ++i)
+        {
+          for (uint32_t j = resident; j < mipmaps_or_count; ++j)
+          {
+            const auto [raw_data, raw_size] = interops.at(i * mipmaps_or_count + j);
+
+            const uint32_t layer = i;
+            const uint32_t mipmap = j - resident;
+            const uint32_t extent_x = std::max(1u, size_x >> j);
+            const uint32_t extent_y = std::max(1u, size_y >> j);
+            const uint32_t extent_z = std::max(1u, size_z >> j);
+
+            const auto slice_rows = (extent_y + block - 1) / block;
+            const auto row_count = slice_rows * extent_z;
+            const auto row_size = raw_size / row_count;
+            BLAST_ASSERT(row_size * row_count == raw_size && row_size <= staging_size);
+
+            // Copy offsets have to be a multiple of both the texel or block size and four
+            const auto texel_size = std::max(VkDeviceSize{ 1 }, row_size / ((extent_x + block - 1) / block));
+            const auto alignment = std::lcm(texel_size, VkDeviceSize{ 4 });
+
+            for (uint32_t row = 0; row < row_count;)
+            {
+              const auto z = row / slice_rows;
+              const auto y = row % slice_rows;
+              const auto slices = y == 0 ? uint32_t(std::min(VkDeviceSize(extent_z - z), staging_size / (row_size * slice_rows))) : 0u;
+              const auto rows = slices > 0 ? slices * slice_rows : uint32_t(std::min(VkDeviceSize(slice_rows - y), staging_size / row_size));
+
+              auto& piece = pieces.emplace_back();
+              piece.data = reinterpret_cast<const uint8_t*>(raw_data) + row * row_size;
+              piece.size = rows * row_size;
+              piece.alignment = alignment;
+              piece.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+              piece.region.imageSubresource.mipLevel = mipmap;
+              piece.region.imageSubresource.baseArrayLayer = layer;
+              piece.region.imageSubresource.layerCount = 1;
+              piece.region.imageOffset = { 0, int32_t(y * block), int32_t(z) };
+              piece.region.imageExtent = slices > 0 ? VkExtent3D{ extent_x, extent_y, slices }
+                : VkExtent3D{ extent_x, std::min(rows * block, extent_y - y * block), 1 };
+
+              row += rows;
+            }
+          }
+        }
+
         VkCommandBufferAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = device->GetCommandPool();
+        allocInfo.commandPool = device->GetTransferPool();
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer;
         BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device->GetDevice(), &allocInfo, &commandBuffer));
 
-        for (uint32_t i = 0; i < layers_or_stride; ++i)
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipmaps_or_count - resident, 0, layers_or_stride };
+
+        // Pieces are packed into staging back to back, a new submission starts only when staging is full
+        std::vector<VkBufferImageCopy> regions;
+        auto submissions = 0u;
+        for (size_t first = 0; first < pieces.size();)
         {
-          for (uint32_t j = 0; j < mipmaps_or_count; ++j)
+          void* mapped = nullptr;
+          BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+
+          regions.clear();
+          auto offset = VkDeviceSize{ 0 };
+          auto last = first;
+          for (; last < pieces.size(); ++last)
           {
-            const auto [raw_data, raw_size] = interops.at(i * mipmaps_or_count + j);
-            BLAST_ASSERT(raw_size <= staging_size);
+            const auto& piece = pieces[last];
+            const auto aligned = (offset + piece.alignment - 1) / piece.alignment * piece.alignment;
+            if (aligned + piece.size > staging_size) break;
+
+            memcpy(reinterpret_cast<uint8_t*>(mapped) + aligned, piece.data, piece.size);
+            regions.push_back(piece.region);
+            regions.back().bufferOffset = aligned;
+            offset = aligned + piece.size;
+          }
+          BLAST_ASSERT(last > first);
 
-            void* mapped = nullptr;
-            BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
-            memcpy(mapped, raw_data, raw_size);
-            vkUnmapMemory(device->GetDevice(), staging_memory);
+          vkUnmapMemory(device->GetDevice(), staging_memory);
 
-            VkCommandBufferBeginInfo beginInfo{};
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT; // VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(commandBuffer, &beginInfo));
+          VkCommandBufferBeginInfo beginInfo{};
+          beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+          beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+          BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(commandBuffer, &beginInfo));
 
-            const uint32_t layer = i;
-            const uint32_t mipmap = j;
-            const uint32_t extent_x = std::max(1u, size_x >> j);
-            const uint32_t extent_y = std::max(1u, size_y >> j);
-            const uint32_t extent_z = std::max(1u, size_z >> j);
+          if (first == 0)
+          {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            vkCmdPipelineBarrier(commandBuffer,
+              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+              0, nullptr,
+              0, nullptr,
+              1, &barrier);
+          }
 
-            {
-              VkImageMemoryBarrier barrier = {};
-              barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-              barrier.srcAccessMask = 0;
-              barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-              barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-              barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-              barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-              barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-              barrier.image = image;
-              barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-              barrier.subresourceRange.baseMipLevel = mipmap;
-              barrier.subresourceRange.levelCount = 1;
-              barrier.subresourceRange.baseArrayLayer = layer;
-              barrier.subresourceRange.layerCount = 1;
-              vkCmdPipelineBarrier(commandBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-            }
+          vkCmdCopyBufferToImage(commandBuffer, staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            uint32_t(regions.size()), regions.data());
 
-            VkBufferImageCopy region = {};
-            region.bufferOffset = 0;
-            region.bufferRowLength = 0;
-            region.bufferImageHeight = 0;
-            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            region.imageSubresource.mipLevel = mipmap;
-            region.imageSubresource.baseArrayLayer = layer;
-            region.imageSubresource.layerCount = 1;
-            region.imageOffset = { 0, 0, 0 };
-            region.imageExtent = { extent_x, extent_y, extent_z };
-            vkCmdCopyBufferToImage(commandBuffer, staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+          if (last == pieces.size())
+          {
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = GetShaderLayout();
+            vkCmdPipelineBarrier(commandBuffer,
+              VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+              0, nullptr,
+              0, nullptr,
+              1, &barrier);
+          }
 
+          BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(commandBuffer));
 
-            {
-              VkImageMemoryBarrier barrier = {};
-              barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-              barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-              barrier.dstAccessMask = 0;
-              barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-              barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
-              barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-              barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-              barrier.image = image;
-              barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-              barrier.subresourceRange.baseMipLevel = mipmap;
-              barrier.subresourceRange.levelCount = 1;
-              barrier.subresourceRange.baseArrayLayer = layer;
-              barrier.subresourceRange.layerCount = 1;
-              vkCmdPipelineBarrier(commandBuffer,
-                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                0, nullptr,
-                0, nullptr,
-                1, &barrier);
-            }
-            BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(commandBuffer));
+          device->Wait(device->Submit(device->GetTransferQueue(), commandBuffer));
 
-            VkSubmitInfo submitInfo{};
-            submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &commandBuffer;
+          submissions += 1;
+          first = last;
+        }
+
+        BLAST_LOG("Uploaded %d subresources in %d submissions [%s]", layers_or_stride * (mipmaps_or_count - resident), submissions, name.c_str());
 
-            BLAST_ASSERT(VK_SUCCESS == vkQueueSubmit(device->GetQueue(), 1, &submitInfo, VK_NULL_HANDLE));
-            BLAST_ASSERT(VK_SUCCESS == vkQueueWaitIdle(device->GetQueue()));
+        // Mipmaps not backed yet are never transitioned, views do not reach them
+        for (uint32_t i = 0; i < layers_or_stride; ++i)
+        {
+          for (uint32_t j = resident; j < mipmaps_or_count; ++j)
+          {
+            layouts.at(i * mipmaps_or_count + j) = GetShaderLayout();
           }
         }
 
-        vkFreeCommandBuffers(device->GetDevice(), device->GetCommandPool(), 1, &commandBuffer);
+        vkFreeCommandBuffers(device->GetDevice(), device->GetTransferPool(), 1, &commandBuffer);
       }
       break;
     }
@@ -526,6 +692,24 @@ namespace RayGene3D
 
     const auto& device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
 
+    if (device && upload.image)
+    {
+      device->Wait(upload.point);
+      vkDestroyImage(device->GetDevice(), upload.image, nullptr);
+      device->FreeMemory(upload.memory);
+      Release(upload);
+    }
+
+    // Pages go back to the pool, the fallback only kept the bookkeeping
+    if (device && sparse)
+    {
+      for (const auto& [key, page] : pages)
+      {
+        device->FreePage(page.first, page.second);
+      }
+    }
+    pages.clear();
+
     if (device)
     {
       switch (type)
@@ -552,11 +736,714 @@ namespace RayGene3D
       }
       }
 
+      if (mapped)
+      {
+        vkUnmapMemory(device->GetDevice(), memory);
+        mapped = nullptr;
+      }
+
       if (memory)
       {
-        vkFreeMemory(device->GetDevice(), memory, nullptr);
+        device->FreeMemory(memory);
         memory = nullptr;
       }
+      external = false;
+    }
+
+    write_stages = 0;
+    write_accesses = 0;
+    read_stages = 0;
+    read_accesses = 0;
+
+    layouts.clear();
+    aliases.clear();
+    pending = false;
+  }
+
+  void VLKResource::Place(VkDeviceMemory memory, VkDeviceSize offset, const std::vector<VLKResource*>& aliases)
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    BLAST_ASSERT(VK_SUCCESS == vkBindImageMemory(device->GetDevice(), image, memory, offset));
+    this->aliases = aliases;
+    pending = false;
+
+    for (const auto& view : views)
+    {
+      view->Discard();
+      view->Initialize();
+    }
+  }
+
+  bool VLKResource::ImportInterops()
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    // Suitably aligned host data is copied from directly, without passing through staging
+    auto sources = std::vector<std::pair<VkBuffer, VkDeviceMemory>>();
+    for (const auto& [interop_data, interop_size] : interops)
+    {
+      if (!device->GetHostImportable(interop_data, interop_size)) break;
+
+      const auto source = device->CreateBuffer(interop_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 0, true);
+      const auto memory = device->ImportMemory(interop_data, interop_size,
+        device->GetRequirements(source).memoryTypeBits, VLKDevice::CATEGORY_STAGING, name);
+      if (memory == nullptr)
+      {
+        vkDestroyBuffer(device->GetDevice(), source, nullptr);
+        break;
+      }
+
+      BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), source, memory, 0));
+      sources.push_back({ source, memory });
+    }
+
+    const auto imported = sources.size() == interops.size();
+    if (imported)
+    {
+      VkCommandBufferAllocateInfo allocate_info{};
+      allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+      allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+      allocate_info.commandPool = device->GetTransferPool();
+      allocate_info.commandBufferCount = 1;
+
+      VkCommandBuffer command_buffer{ nullptr };
+      BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device->GetDevice(), &allocate_info, &command_buffer));
+
+      VkCommandBufferBeginInfo begin_info{};
+      begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+      begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+      BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &begin_info));
+
+      auto offset = VkDeviceSize{ 0 };
+      for (uint32_t i = 0; i < uint32_t(sources.size()); ++i)
+      {
+        VkBufferCopy region{};
+        region.srcOffset = 0;
+        region.dstOffset = offset;
+        region.size = interops[i].second;
+        vkCmdCopyBuffer(command_buffer, sources[i].first, buffer, 1, &region);
+        offset += interops[i].second;
+      }
+      BLAST_ASSERT(offset == VkDeviceSize(mipmaps_or_count) * layers_or_stride);
+
+      BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
+      device->Wait(device->Submit(device->GetTransferQueue(), command_buffer));
+      vkFreeCommandBuffers(device->GetDevice(), device->GetTransferPool(), 1, &command_buffer);
+
+      BLAST_LOG("Copied %llu bytes from imported host memory [%s]", static_cast<unsigned long long>(offset), name.c_str());
+    }
+
+    for (const auto& [source, memory] : sources)
+    {
+      vkDestroyBuffer(device->GetDevice(), source, nullptr);
+      device->FreeMemory(memory);
+    }
+
+    return imported;
+  }
+
+  bool VLKResource::BindTail()
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+    const auto requirements = device->GetRequirements(image);
+
+    auto count = uint32_t{ 0 };
+    vkGetImageSparseMemoryRequirements(device->GetDevice(), image, &count, nullptr);
+    auto sparse_requirements = std::vector<VkSparseImageMemoryRequirements>(count);
+    vkGetImageSparseMemoryRequirements(device->GetDevice(), image, &count, sparse_requirements.data());
+
+    // Separate depth/stencil or metadata tails and tiles larger than a pool page are not handled
+    if (count != 1 || (sparse_requirements[0].formatProperties.aspectMask & VK_IMAGE_ASPECT_METADATA_BIT)
+      || device->GetPageSize() % requirements.alignment != 0)
+    {
+      return false;
+    }
+
+    const auto& properties = sparse_requirements[0];
+    this->sparse = true;
+    this->page_bits = requirements.memoryTypeBits;
+    this->tile_extent = properties.formatProperties.imageGranularity;
+    this->tail_first = std::min(properties.imageMipTailFirstLod, mipmaps_or_count);
+
+    if (tail_first == mipmaps_or_count)
+    {
+      return true;
+    }
+
+    // The tail is bound once and stays resident for the lifetime of the image
+    const auto single = (properties.formatProperties.flags & VK_SPARSE_IMAGE_FORMAT_SINGLE_MIPTAIL_BIT) != 0;
+    const auto tails = single ? 1u : layers_or_stride;
+    const auto tail_size = (properties.imageMipTailSize + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+    const auto index = device->GetMemoryIndex(VLKDevice::MEMORY_DEVICE, requirements.memoryTypeBits, tail_size * tails);
+    BLAST_LOG("Allocating %llu bytes of mipmap tail from type %d heap %d [%s]", static_cast<unsigned long long>(tail_size * tails),
+      index, device->GetMemoryHeap(index), name.c_str());
+    this->memory = device->AllocateMemory(tail_size * tails, index, false, VLKDevice::CATEGORY_IMAGE, name);
+
+    auto binds = std::vector<VkSparseMemoryBind>(tails);
+    for (uint32_t i = 0; i < tails; ++i)
+    {
+      binds[i].resourceOffset = properties.imageMipTailOffset + i * properties.imageMipTailStride;
+      binds[i].size = properties.imageMipTailSize;
+      binds[i].memory = memory;
+      binds[i].memoryOffset = i * tail_size;
+    }
+
+    auto opaque_info = VkSparseImageOpaqueMemoryBindInfo{};
+    opaque_info.image = image;
+    opaque_info.bindCount = tails;
+    opaque_info.pBinds = binds.data();
+
+    auto bind_info = VkBindSparseInfo{};
+    bind_info.imageOpaqueBindCount = 1;
+    bind_info.pImageOpaqueBinds = &opaque_info;
+    device->Wait(device->BindSparse(bind_info));
+
+    return true;
+  }
+
+  uint64_t VLKResource::GetTileKey(uint32_t mipmap, uint32_t layer, uint32_t x, uint32_t y, uint32_t z)
+  {
+    return (uint64_t(layer) << 48) | (uint64_t(mipmap) << 40) | (uint64_t(z) << 28) | (uint64_t(y) << 14) | uint64_t(x);
+  }
+
+  void VLKResource::BindPages(std::vector<VkSparseMemoryBind>& buffer_binds, std::vector<VkSparseImageMemoryBind>& image_binds,
+    std::vector<std::pair<VkDeviceMemory, VkDeviceSize>>& released)
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    if (buffer_binds.empty() && image_binds.empty())
+    {
+      return;
+    }
+
+    auto buffer_info = VkSparseBufferMemoryBindInfo{};
+    buffer_info.buffer = buffer;
+    buffer_info.bindCount = uint32_t(buffer_binds.size());
+    buffer_info.pBinds = buffer_binds.data();
+
+    auto image_info = VkSparseImageMemoryBindInfo{};
+    image_info.image = image;
+    image_info.bindCount = uint32_t(image_binds.size());
+    image_info.pBinds = image_binds.data();
+
+    auto bind_info = VkBindSparseInfo{};
+    bind_info.bufferBindCount = buffer_binds.empty() ? 0 : 1;
+    bind_info.pBufferBinds = &buffer_info;
+    bind_info.imageBindCount = image_binds.empty() ? 0 : 1;
+    bind_info.pImageBinds = &image_info;
+    device->Wait(device->BindSparse(bind_info));
+
+    for (const auto& [memory, offset] : released)
+    {
+      device->FreePage(memory, offset);
+    }
+  }
+
+  void VLKResource::CommitPages(VkDeviceSize offset, VkDeviceSize size, bool resident)
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+    BLAST_ASSERT(type == TYPE_BUFFER);
+
+    const auto total = sparse ? device->GetRequirements(buffer).size : VkDeviceSize(mipmaps_or_count) * layers_or_stride;
+    const auto first = offset / page_size;
+    const auto last = std::min(offset + size, total);
+
+    // Pages still read by submitted work are unbound only once it retires
+    if (!resident && sparse)
+    {
+      device->Wait(device->GetPoint());
+    }
+
+    auto buffer_binds = std::vector<VkSparseMemoryBind>();
+    auto image_binds = std::vector<VkSparseImageMemoryBind>();
+    auto released = std::vector<std::pair<VkDeviceMemory, VkDeviceSize>>();
+
+    for (auto i = first; i * page_size < last; ++i)
+    {
+      const auto page = pages.find(i);
+      if ((page != pages.end()) == resident) continue;
+
+      auto bind = VkSparseMemoryBind{};
+      bind.resourceOffset = i * page_size;
+      bind.size = std::min(page_size, total - bind.resourceOffset);
+
+      if (resident)
+      {
+        const auto backing = sparse ? device->AllocatePage(page_bits) : std::pair<VkDeviceMemory, VkDeviceSize>{ nullptr, 0 };
+        bind.memory = backing.first;
+        bind.memoryOffset = backing.second;
+        pages[i] = backing;
+      }
+      else
+      {
+        released.push_back(page->second);
+        pages.erase(page);
+      }
+
+      if (sparse) buffer_binds.push_back(bind);
+    }
+
+    BindPages(buffer_binds, image_binds, released);
+  }
+
+  void VLKResource::CommitTiles(uint32_t mipmap, uint32_t layer, VkOffset3D offset, VkExtent3D extent, bool resident)
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+    BLAST_ASSERT(type != TYPE_BUFFER && mipmap < mipmaps_or_count && layer < layers_or_stride);
+
+    // Mipmaps of the tail are always resident
+    if (mipmap >= tail_first)
+    {
+      return;
+    }
+
+    const auto size = VkExtent3D{ std::max(1u, size_x >> mipmap), std::max(1u, size_y >> mipmap), std::max(1u, size_z >> mipmap) };
+    const auto begin = VkExtent3D{ uint32_t(offset.x) / tile_extent.width, uint32_t(offset.y) / tile_extent.height, uint32_t(offset.z) / tile_extent.depth };
+    const auto end = VkExtent3D{
+      (std::min(offset.x + extent.width, size.width) + tile_extent.width - 1) / tile_extent.width,
+      (std::min(offset.y + extent.height, size.height) + tile_extent.height - 1) / tile_extent.height,
+      (std::min(offset.z + extent.depth, size.depth) + tile_extent.depth - 1) / tile_extent.depth };
+
+    if (!resident && sparse)
+    {
+      device->Wait(device->GetPoint());
+    }
+
+    auto buffer_binds = std::vector<VkSparseMemoryBind>();
+    auto image_binds = std::vector<VkSparseImageMemoryBind>();
+    auto released = std::vector<std::pair<VkDeviceMemory, VkDeviceSize>>();
+
+    for (auto z = begin.depth; z < end.depth; ++z)
+    for (auto y = begin.height; y < end.height; ++y)
+    for (auto x = begin.width; x < end.width; ++x)
+    {
+      const auto key = GetTileKey(mipmap, layer, x, y, z);
+      const auto page = pages.find(key);
+      if ((page != pages.end()) == resident) continue;
+
+      auto bind = VkSparseImageMemoryBind{};
+      bind.subresource = { GetAspect(), mipmap, layer };
+      bind.offset = { int32_t(x * tile_extent.width), int32_t(y * tile_extent.height), int32_t(z * tile_extent.depth) };
+      bind.extent = { std::min(tile_extent.width, size.width - x * tile_extent.width),
+        std::min(tile_extent.height, size.height - y * tile_extent.height),
+        std::min(tile_extent.depth, size.depth - z * tile_extent.depth) };
+
+      if (resident)
+      {
+        const auto backing = sparse ? device->AllocatePage(page_bits) : std::pair<VkDeviceMemory, VkDeviceSize>{ nullptr, 0 };
+        bind.memory = backing.first;
+        bind.memoryOffset = backing.second;
+        pages[key] = backing;
+      }
+      else
+      {
+        released.push_back(page->second);
+        pages.erase(page);
+      }
+
+      if (sparse) image_binds.push_back(bind);
+    }
+
+    BindPages(buffer_binds, image_binds, released);
+  }
+
+  bool VLKResource::IsCommitted(VkDeviceSize offset) const
+  {
+    return pages.count(offset / page_size) != 0;
+  }
+
+  bool VLKResource::IsCommitted(uint32_t mipmap, uint32_t layer, VkOffset3D texel) const
+  {
+    if (mipmap >= tail_first)
+    {
+      return true;
+    }
+
+    return pages.count(GetTileKey(mipmap, layer, uint32_t(texel.x) / tile_extent.width,
+      uint32_t(texel.y) / tile_extent.height, uint32_t(texel.z) / tile_extent.depth)) != 0;
+  }
+
+  uint32_t VLKResource::GetTail() const
+  {
+    // Mipmaps of 128 texels and below stay resident from creation on
+    const auto size = std::max(size_x, std::max(size_y, size_z));
+    uint32_t mipmap = 0;
+    while (mipmap + 1 < mipmaps_or_count && (size >> mipmap) > 128) ++mipmap;
+    return mipmap;
+  }
+
+  bool VLKResource::Stream(uint32_t mipmap)
+  {
+    const auto target = std::min(mipmap, GetTail());
+    if (upload.image || target == resident) return false;
+
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    const auto extent = VkExtent3D{ std::max(1u, size_x >> target), std::max(1u, size_y >> target), std::max(1u, size_z >> target) };
+    const auto image = device->CreateImage(image_type, image_format, extent, mipmaps_or_count - target, layers_or_stride, image_usage, image_flags);
+    const auto requirements = device->GetRequirements(image);
+    const auto index = device->GetMemoryIndex(VLKDevice::MEMORY_DEVICE, requirements.memoryTypeBits, requirements.size);
+
+    // Finer mipmaps are only streamed in while the device heap has room for them
+    const auto heap = device->GetMemoryHeap(index);
+    if (target < resident && device->GetHeapUsage(heap) + requirements.size > device->GetHeapBudget(heap))
+    {
+      vkDestroyImage(device->GetDevice(), image, nullptr);
+      return false;
+    }
+
+    BLAST_LOG("Streaming %llu bytes for mipmaps %d-%d [%s]", static_cast<unsigned long long>(requirements.size), target, mipmaps_or_count - 1, name.c_str());
+    const auto memory = device->AllocateMemory(requirements.size, index, false, VLKDevice::CATEGORY_IMAGE, name);
+    BLAST_ASSERT(VK_SUCCESS == vkBindImageMemory(device->GetDevice(), image, memory, 0));
+
+    // All mipmaps of all layers are packed into one staging buffer of their own
+    std::vector<VkBufferImageCopy> regions;
+    VkDeviceSize staging_size = 0;
+    const auto block = image_format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && image_format <= VK_FORMAT_BC7_SRGB_BLOCK ? 4u : 1u;
+    for (uint32_t i = 0; i < layers_or_stride; ++i)
+    {
+      for (uint32_t j = target; j < mipmaps_or_count; ++j)
+      {
+        const auto raw_size = interops.at(i * mipmaps_or_count + j).second;
+        const auto extent = VkExtent3D{ std::max(1u, size_x >> j), std::max(1u, size_y >> j), std::max(1u, size_z >> j) };
+
+        // Copy offsets have to be a multiple of both the texel or block size and four
+        const auto blocks = VkDeviceSize((extent.width + block - 1) / block) * ((extent.height + block - 1) / block) * extent.depth;
+        const auto texel_size = std::max(VkDeviceSize{ 1 }, raw_size / blocks);
+        const auto alignment = std::lcm(texel_size, VkDeviceSize{ 4 });
+        staging_size = (staging_size + alignment - 1) / alignment * alignment;
+
+        auto& region = regions.emplace_back();
+        region.bufferOffset = staging_size;
+        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, j - target, i, 1 };
+        region.imageExtent = extent;
+        staging_size += raw_size;
+      }
+    }
+
+    const auto staging_buffer = device->CreateBuffer(staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+    const auto staging_requirements = device->GetRequirements(staging_buffer);
+    const auto staging_index = device->GetMemoryIndex(VLKDevice::MEMORY_SYSTEM, staging_requirements.memoryTypeBits, staging_requirements.size);
+    const auto staging_memory = device->AllocateMemory(staging_requirements.size, staging_index, false, VLKDevice::CATEGORY_STAGING, name);
+    BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), staging_buffer, staging_memory, 0));
+
+    void* mapped = nullptr;
+    BLAST_ASSERT(VK_SUCCESS == vkMapMemory(device->GetDevice(), staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    for (uint32_t i = 0, k = 0; i < layers_or_stride; ++i)
+    {
+      for (uint32_t j = target; j < mipmaps_or_count; ++j, ++k)
+      {
+        const auto [raw_data, raw_size] = interops.at(i * mipmaps_or_count + j);
+        memcpy(reinterpret_cast<uint8_t*>(mapped) + regions[k].bufferOffset, raw_data, raw_size);
+      }
+    }
+    vkUnmapMemory(device->GetDevice(), staging_memory);
+
+    VkCommandBufferAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandPool = device->GetTransferPool();
+    allocate_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer{ nullptr };
+    BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device->GetDevice(), &allocate_info, &command_buffer));
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipmaps_or_count - target, 0, layers_or_stride };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(regions.size()), regions.data());
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = GetShaderLayout();
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
+
+    // Not waited for, the image is swapped in once the device is done with it
+    const auto point = device->Submit(device->GetTransferQueue(), command_buffer);
+    upload = { target, image, memory, staging_buffer, staging_memory, command_buffer, point };
+
+    return true;
+  }
+
+  bool VLKResource::Swap()
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+    if (!upload.image || !device->IsComplete(upload.point)) return false;
+
+    for (const auto& view : views)
+    {
+      view->Discard();
+    }
+
+    vkDestroyImage(device->GetDevice(), image, nullptr);
+    device->FreeMemory(memory);
+
+    image = upload.image;
+    memory = upload.memory;
+    resident = upload.resident;
+    Release(upload);
+
+    // The upload left every backed mipmap in shader layout, dropped ones are not transitioned anymore
+    for (uint32_t i = 0; i < layers_or_stride; ++i)
+    {
+      for (uint32_t j = 0; j < mipmaps_or_count; ++j)
+      {
+        layouts.at(i * mipmaps_or_count + j) = j < resident ? VK_IMAGE_LAYOUT_UNDEFINED : GetShaderLayout();
+      }
+    }
+
+    for (const auto& view : views)
+    {
+      view->Initialize();
+    }
+
+    return true;
+  }
+
+  void VLKResource::Release(Upload& upload)
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    vkFreeCommandBuffers(device->GetDevice(), device->GetTransferPool(), 1, &upload.command_buffer);
+    vkDestroyBuffer(device->GetDevice(), upload.staging_buffer, nullptr);
+    device->FreeMemory(upload.staging_memory);
+    upload = {};
+  }
+
+  bool VLKResource::GetEvictable() const
+  {
+    // Host visible buffers already live where eviction would put them, addresses may be baked into structures
+    const auto pinned = HINT_DYNAMIC_BUFFER | HINT_READBACK_BUFFER | HINT_ADDRESS_BUFFER | HINT_EXTERNAL_BUFFER;
+    return type == TYPE_BUFFER && buffer && memory && (hint & pinned) == 0;
+  }
+
+  bool VLKResource::Relocate(bool evict)
+  {
+    const auto device = reinterpret_cast<VLKDevice*>(&this->GetDevice());
+
+    const auto size = VkDeviceSize(mipmaps_or_count) * layers_or_stride;
+    const auto buffer = device->CreateBuffer(size, buffer_usage);
+    const auto requirements = device->GetRequirements(buffer);
+    const auto memory_class = evict ? VLKDevice::MEMORY_SYSTEM : VLKDevice::MEMORY_DEVICE;
+    const auto index = device->GetMemoryIndex(memory_class, requirements.memoryTypeBits, requirements.size);
+
+    // Coming back only pays off while the device heap has room for it
+    const auto heap = device->GetMemoryHeap(index);
+    if (index >= device->GetMemoryCount() || (!evict && device->GetHeapUsage(heap) + requirements.size > device->GetHeapBudget(heap)))
+    {
+      vkDestroyBuffer(device->GetDevice(), buffer, nullptr);
+      return false;
+    }
+
+    BLAST_LOG("%s %llu bytes as %s from type %d heap %d [%s]", evict ? "Evicting" : "Restoring", static_cast<unsigned long long>(requirements.size),
+      VLKDevice::GetClassName(memory_class), index, heap, name.c_str());
+    const auto memory = device->AllocateMemory(requirements.size, index, false, VLKDevice::CATEGORY_BUFFER, name);
+    BLAST_ASSERT(VK_SUCCESS == vkBindBufferMemory(device->GetDevice(), buffer, memory, 0));
+
+    VkCommandBufferAllocateInfo allocate_info{};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandPool = device->GetCommandPool();
+    allocate_info.commandBufferCount = 1;
+
+    VkCommandBuffer command_buffer{ nullptr };
+    BLAST_ASSERT(VK_SUCCESS == vkAllocateCommandBuffers(device->GetDevice(), &allocate_info, &command_buffer));
+
+    VkCommandBufferBeginInfo begin_info{};
+    begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    BLAST_ASSERT(VK_SUCCESS == vkBeginCommandBuffer(command_buffer, &begin_info));
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+      0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    VkBufferCopy region{};
+    region.size = size;
+    vkCmdCopyBuffer(command_buffer, this->buffer, buffer, 1, &region);
+
+    BLAST_ASSERT(VK_SUCCESS == vkEndCommandBuffer(command_buffer));
+    device->Wait(device->Submit(device->GetQueue(), command_buffer));
+    vkFreeCommandBuffers(device->GetDevice(), device->GetCommandPool(), 1, &command_buffer);
+
+    vkDestroyBuffer(device->GetDevice(), this->buffer, nullptr);
+    device->FreeMemory(this->memory);
+
+    // The copy has finished, later uses only need the transfer to be visible
+    this->buffer = buffer;
+    this->memory = memory;
+    this->evicted = evict;
+    write_stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    write_accesses = VK_ACCESS_TRANSFER_WRITE_BIT;
+    read_stages = 0;
+    read_accesses = 0;
+
+    return true;
+  }
+
+  void VLKResource::Acquire(VkPipelineStageFlags& src_stages, VkAccessFlags& src_accesses)
+  {
+    // Whatever used the memory before is finished with, the contents are not kept
+    for (const auto alias : aliases)
+    {
+      src_stages |= alias->write_stages | alias->read_stages;
+      src_accesses |= alias->write_accesses;
+    }
+
+    std::fill(layouts.begin(), layouts.end(), VK_IMAGE_LAYOUT_UNDEFINED);
+  }
+
+  VkImageAspectFlags VLKResource::GetAspect() const
+  {
+    switch (format)
+    {
+    case FORMAT_D32_FLOAT:
+    case FORMAT_D16_UNORM: return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case FORMAT_D32_FLOAT_S8X24_UINT:
+    case FORMAT_D24_UNORM_S8_UINT: return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default: return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+  }
+
+  void VLKResource::Transition(const View::Range& mipmaps, const View::Range& layers, VkImageLayout layout, bool discard,
+    VkPipelineStageFlags stages, VkAccessFlags accesses,
+    VkPipelineStageFlags& src_stages, VkPipelineStageFlags& dst_stages,
+    std::vector<VkImageMemoryBarrier>& barriers)
+  {
+    if (layouts.empty()) return;
+
+    // Mipmaps finer than the resident one are not backed by the image, its levels start from the resident one
+    const auto mipmap_end = uint32_t(mipmaps.length == uint64_t(-1) ? mipmaps_or_count : mipmaps.offset + mipmaps.length);
+    const auto mipmap_offset = std::min(std::max(uint32_t(mipmaps.offset), resident), mipmap_end);
+    const auto mipmap_count = mipmap_end - mipmap_offset;
+    if (mipmap_count == 0) return;
+    const auto layer_offset = uint32_t(layers.offset);
+    const auto layer_count = uint32_t(layers.length == uint64_t(-1) ? layers_or_stride - layers.offset : layers.length);
+
+    const auto barrier_fn = [this, layout, discard, accesses, &barriers](uint32_t layer, uint32_t mipmap, uint32_t count)
+    {
+      const auto old_layout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : layouts.at(layer * mipmaps_or_count + mipmap);
+
+      // Layers sharing the same mipmap run and old layout go into a single barrier
+      if (!barriers.empty())
+      {
+        auto& barrier = barriers.back();
+        if (barrier.image == image && barrier.oldLayout == old_layout && barrier.newLayout == layout
+          && barrier.subresourceRange.baseMipLevel == mipmap - resident && barrier.subresourceRange.levelCount == count
+          && barrier.subresourceRange.baseArrayLayer + barrier.subresourceRange.layerCount == layer)
+        {
+          barrier.subresourceRange.layerCount += 1;
+          return;
+        }
+      }
+
+      VkImageMemoryBarrier barrier = {};
+      barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+      barrier.srcAccessMask = write_accesses;
+      barrier.dstAccessMask = accesses;
+      barrier.oldLayout = old_layout;
+      barrier.newLayout = layout;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange = { GetAspect(), mipmap - resident, count, layer, 1 };
+      barriers.push_back(barrier);
+    };
+
+    auto transited = false;
+    for (uint32_t i = layer_offset; i < layer_offset + layer_count; ++i)
+    {
+      // Consecutive mipmaps with the same layout are transited together
+      uint32_t first = mipmap_offset;
+      for (uint32_t j = mipmap_offset; j <= mipmap_offset + mipmap_count; ++j)
+      {
+        const auto run_ended = j == mipmap_offset + mipmap_count
+          || layouts.at(i * mipmaps_or_count + j) != layouts.at(i * mipmaps_or_count + first);
+        if (!run_ended) continue;
+
+        if (layouts.at(i * mipmaps_or_count + first) != layout)
+        {
+          barrier_fn(i, first, j - first);
+          transited = true;
+        }
+        first = j;
+      }
+
+      for (uint32_t j = mipmap_offset; j < mipmap_offset + mipmap_count; ++j)
+      {
+        layouts.at(i * mipmaps_or_count + j) = layout;
+      }
+    }
+
+    if (transited)
+    {
+      const auto prior_stages = write_stages | read_stages;
+      src_stages |= prior_stages != 0 ? prior_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+      dst_stages |= stages;
+    }
+  }
+
+  void VLKResource::Track(VkPipelineStageFlags stages, VkAccessFlags accesses, bool write,
+    VkPipelineStageFlags& src_stages, VkAccessFlags& src_accesses,
+    VkPipelineStageFlags& dst_stages, VkAccessFlags& dst_accesses)
+  {
+    if (write)
+    {
+      // Write after write needs the previous write made available, write after read only has to wait for readers
+      if (write_stages != 0)
+      {
+        src_stages |= write_stages;
+        src_accesses |= write_accesses;
+        dst_stages |= stages;
+        dst_accesses |= accesses;
+      }
+      if (read_stages != 0)
+      {
+        src_stages |= read_stages;
+        dst_stages |= stages;
+      }
+
+      write_stages = stages;
+      write_accesses = accesses;
+      read_stages = 0;
+      read_accesses = 0;
+    }
+    else
+    {
+      // Reads are synchronized once per stage and access after the last write
+      if (write_stages != 0 && ((read_stages & stages) != stages || (read_accesses & accesses) != accesses))
+      {
+        src_stages |= write_stages;
+        src_accesses |= write_accesses;
+        dst_stages |= stages;
+        dst_accesses |= accesses;
+      }
+
+      read_stages |= stages;
+      read_accesses |= accesses;
     }
   }
 
@@ -575,6 +1462,10 @@ namespace RayGene3D
 
   void* VLKResource::Map()
   {
+    // Readback memory may be cached on the host and is refreshed on every map
+    if (mapped && (hint & HINT_READBACK_BUFFER)) reinterpret_cast<VLKDevice*>(&this->GetDevice())->InvalidateMemory(memory);
+    if (mapped) return mapped;
+
     const auto& device = reinterpret_cast<VLKDevice*>(&this->GetDevice())->GetDevice();
 
     void* data = nullptr;
@@ -584,6 +1475,8 @@ namespace RayGene3D
 
   void VLKResource::Unmap() 
   {
+    if (mapped) return;
+
     const auto& device = reinterpret_cast<VLKDevice*>(&this->GetDevice())->GetDevice();
 
     vkUnmapMemory(device, memory);
@@ -605,7 +1498,7 @@ namespace RayGene3D
     Device& device,
     const Resource::BufferDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     VLKResource::Initialize();
@@ -615,7 +1508,7 @@ namespace RayGene3D
     Device& device,
     const Resource::Tex1DDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     VLKResource::Initialize();
@@ -625,7 +1518,7 @@ namespace RayGene3D
     Device& device,
     const Resource::Tex2DDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     VLKResource::Initialize();
@@ -635,7 +1528,7 @@ namespace RayGene3D
     Device& device,
     const Resource::Tex3DDesc& desc,
     Resource::Hint hint,
-    const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops)
+    const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
     : Resource(name, device, desc, hint, interops)
   {
     VLKResource::Initialize();
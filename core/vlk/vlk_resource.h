@@ -50,12 +50,59 @@ namespace RayGene3D
     VkDeviceMemory memory{ nullptr };
     VkBuffer buffer{ nullptr };
     VkImage image{ nullptr };
+    void* mapped{ nullptr }; // kept mapped for dynamic buffers
+    bool external{ false }; // memory imported from the interop host allocation
+    VkBufferUsageFlags buffer_usage{ 0 };
+
+  protected:
+    VkImageType image_type{ VK_IMAGE_TYPE_MAX_ENUM };
+    VkFormat image_format{ VK_FORMAT_UNDEFINED };
+    VkImageUsageFlags image_usage{ 0 };
+    VkImageCreateFlags image_flags{ 0 };
+
+  protected:
+    uint32_t resident{ 0 }; // finest mipmap backed by the image
+    struct Upload
+    {
+      uint32_t resident{ 0 };
+      VkImage image{ nullptr };
+      VkDeviceMemory memory{ nullptr };
+      VkBuffer staging_buffer{ nullptr };
+      VkDeviceMemory staging_memory{ nullptr };
+      VkCommandBuffer command_buffer{ nullptr };
+      uint64_t point{ 0 };
+    };
+    Upload upload; // replacement image in flight
+
+  protected:
+    uint64_t last_use{ 0 }; // frame
+    bool evicted{ false }; // moved to host memory
+
+  protected:
+    bool sparse{ false }; // bound page by page
+    uint32_t page_bits{ 0 };
+    VkDeviceSize page_size{ 0 };
+    VkExtent3D tile_extent{ 0, 0, 0 }; // texels per page
+    uint32_t tail_first{ 0 }; // first mipmap of the opaque tail
+    std::map<uint64_t, std::pair<VkDeviceMemory, VkDeviceSize>> pages; // committed, by page or tile key
+
+  protected:
+    VkPipelineStageFlags write_stages{ 0 };
+    VkAccessFlags write_accesses{ 0 };
+    VkPipelineStageFlags read_stages{ 0 };
+    VkAccessFlags read_accesses{ 0 };
+
+  protected:
+    std::vector<VkImageLayout> layouts; // per layer and mipmap
+    std::vector<VLKResource*> aliases; // sharing transient memory
+    bool lazy{ false };
+    bool pending{ false }; // transient image not placed yet, nothing to view
 
   public:
     const std::shared_ptr<View>& CreateView(const std::string& name,
       Usage usage, 
-      const View::Range& mipmaps_or_count = View::Range{ 0, uint32_t(-1) },
-      const View::Range& layers_or_stride = View::Range{ 0, uint32_t(-1) },
+      const View::Range& mipmaps_or_count = View::Range{ 0, uint64_t(-1) },
+      const View::Range& layers_or_stride = View::Range{ 0, uint64_t(-1) },
       View::Bind bind = View::BIND_UNKNOWN) override
     {
       return views.emplace_back(new VLKView(name, *this, usage, mipmaps_or_count, layers_or_stride, bind));
@@ -64,6 +111,66 @@ namespace RayGene3D
   public:
     VkBuffer GetBuffer() const { return buffer; }
     VkImage GetImage() const { return image; }
+    VkDeviceMemory GetMemory() const { return memory; }
+
+  public:
+    uint32_t GetResident() const { return resident; }
+    uint32_t GetTail() const;
+    bool GetStreaming() const { return upload.image != nullptr; }
+    bool Stream(uint32_t mipmap);
+    bool Swap();
+
+  protected:
+    void Release(Upload& upload);
+
+  public:
+    void Touch(uint64_t frame) { last_use = frame; }
+    uint64_t GetLastUse() const { return last_use; }
+    bool GetEvicted() const { return evicted; }
+    bool GetEvictable() const;
+    bool Relocate(bool evict);
+
+  public:
+    bool GetSparse() const { return sparse; }
+    VkDeviceSize GetPageSize() const { return page_size; }
+    VkExtent3D GetTileExtent() const { return tile_extent; }
+    void CommitPages(VkDeviceSize offset, VkDeviceSize size, bool resident);
+    void CommitTiles(uint32_t mipmap, uint32_t layer, VkOffset3D offset, VkExtent3D extent, bool resident);
+    bool IsCommitted(VkDeviceSize offset) const;
+    bool IsCommitted(uint32_t mipmap, uint32_t layer, VkOffset3D texel) const;
+
+  protected:
+    bool ImportInterops();
+
+  protected:
+    bool BindTail();
+    void BindPages(std::vector<VkSparseMemoryBind>& buffer_binds, std::vector<VkSparseImageMemoryBind>& image_binds,
+      std::vector<std::pair<VkDeviceMemory, VkDeviceSize>>& released);
+    static uint64_t GetTileKey(uint32_t mipmap, uint32_t layer, uint32_t x, uint32_t y, uint32_t z);
+
+  public:
+    VkImageAspectFlags GetAspect() const;
+    VkImageLayout GetLayout(uint32_t mipmap = 0, uint32_t layer = 0) const { return layouts.empty() ? VK_IMAGE_LAYOUT_UNDEFINED : layouts.at(layer * mipmaps_or_count + mipmap); }
+    VkImageLayout GetShaderLayout() const { return usage & USAGE_UNORDERED_ACCESS ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL; }
+
+  public:
+    void SetLazy(bool lazy) { this->lazy = lazy; }
+    bool GetLazy() const { return lazy; }
+    bool GetPending() const { return pending; }
+
+  public:
+    void Place(VkDeviceMemory memory, VkDeviceSize offset, const std::vector<VLKResource*>& aliases);
+    void Acquire(VkPipelineStageFlags& src_stages, VkAccessFlags& src_accesses);
+    const std::vector<VLKResource*>& GetAliases() const { return aliases; }
+
+  public:
+    void Transition(const View::Range& mipmaps, const View::Range& layers, VkImageLayout layout, bool discard,
+      VkPipelineStageFlags stages, VkAccessFlags accesses,
+      VkPipelineStageFlags& src_stages, VkPipelineStageFlags& dst_stages,
+      std::vector<VkImageMemoryBarrier>& barriers);
+    void Track(VkPipelineStageFlags stages, VkAccessFlags accesses, bool write,
+      VkPipelineStageFlags& src_stages, VkAccessFlags& src_accesses,
+      VkPipelineStageFlags& dst_stages, VkAccessFlags& dst_accesses);
 
   public:
     void Commit(uint32_t index) override;
@@ -84,21 +191,21 @@ namespace RayGene3D
       Device& device,
       const Resource::BufferDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     VLKResource(const std::string& name,
       Device& device,
       const Resource::Tex1DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     VLKResource(const std::string& name,
       Device& device,
       const Resource::Tex2DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     VLKResource(const std::string& name,
       Device& device, const Resource::Tex3DDesc& desc,
       Resource::Hint hint = Resource::HINT_UNKNOWN,
-      const std::pair<std::pair<const void*, uint32_t>*, uint32_t>& interops = {});
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops = {});
     virtual ~VLKResource();
   };
 }
@@ -163,8 +163,9 @@ namespace RayGene3D
       return VK_IMAGE_ASPECT_FLAG_BITS_MAX_ENUM;
     };
 
+    // Transient images have no memory until the schedule places them, their views are created then
     auto image = resource->GetImage();
-    if (image)
+    if (image && !resource->GetPending())
     {
       BLAST_LOG("Creating image view: [%s]", name.c_str());
 
@@ -174,10 +175,14 @@ namespace RayGene3D
       create_info.viewType = get_type();
       create_info.format = get_format();
       create_info.subresourceRange.aspectMask = get_aspect();
-      create_info.subresourceRange.baseMipLevel = mipmaps_or_count.offset;
-      create_info.subresourceRange.levelCount = mipmaps_or_count.length == -1 ? resource->GetMipmapsOrCount() : mipmaps_or_count.length;
-      create_info.subresourceRange.baseArrayLayer = layers_or_stride.offset;
-      create_info.subresourceRange.layerCount = layers_or_stride.length == -1 ? resource->GetLayersOrStride() : layers_or_stride.length;
+      // Streaming images back the mipmaps from the resident one on, coarser views are clamped to those
+      const auto resident = resource->GetResident();
+      const auto mipmap_end = uint32_t(mipmaps_or_count.length == -1 ? resource->GetMipmapsOrCount() : mipmaps_or_count.offset + mipmaps_or_count.length);
+      const auto mipmap_first = std::min(std::max(uint32_t(mipmaps_or_count.offset), resident), resource->GetMipmapsOrCount() - 1);
+      create_info.subresourceRange.baseMipLevel = mipmap_first - resident;
+      create_info.subresourceRange.levelCount = std::max(mipmap_end, mipmap_first + 1) - mipmap_first;
+      create_info.subresourceRange.baseArrayLayer = uint32_t(layers_or_stride.offset);
+      create_info.subresourceRange.layerCount = uint32_t(layers_or_stride.length == -1 ? resource->GetLayersOrStride() : layers_or_stride.length);
 
       //if (create_info.format == VK_FORMAT_D32_SFLOAT && bind != BIND_DEPTH_STENCIL)
       //{
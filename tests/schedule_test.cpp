@@ -0,0 +1,258 @@
+/*================================================================================
+RayGene3D Framework
+--------------------------------------------------------------------------------
+RayGene3D is licensed under MIT License
+================================================================================
+The MIT License
+--------------------------------------------------------------------------------
+Copyright (c) 2021
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+================================================================================*/
+
+
+#include "../core/device.h"
+
+using namespace RayGene3D;
+
+namespace
+{
+  // Backend-free stand-ins, scheduling only looks at hints and the views passes touch
+  class TestView : public View
+  {
+  public:
+    void Initialize() override {}
+    void Use() override {}
+    void Discard() override {}
+
+  public:
+    TestView(const std::string& name, Resource& resource, Usage usage,
+      const View::Range& mipmaps_or_count, const View::Range& layers_or_stride, View::Bind bind)
+      : View(name, resource, usage, mipmaps_or_count, layers_or_stride, bind)
+    {
+    }
+  };
+
+  class TestResource : public Resource
+  {
+  public:
+    void Commit(uint32_t index) override {}
+    void Retrieve(uint32_t index) override {}
+    void Blit(const std::shared_ptr<Resource>& resource) override {}
+    void* Map() override { return nullptr; }
+    void Unmap() override {}
+
+  public:
+    const std::shared_ptr<View>& CreateView(const std::string& name,
+      Usage usage,
+      const View::Range& mipmaps_or_count,
+      const View::Range& layers_or_stride,
+      View::Bind bind) override
+    {
+      return views.emplace_back(new TestView(name, *this, usage, mipmaps_or_count, layers_or_stride, bind));
+    }
+
+  public:
+    void Initialize() override {}
+    void Use() override {}
+    void Discard() override {}
+
+  public:
+    template<typename Desc>
+    TestResource(const std::string& name, Device& device, const Desc& desc, Resource::Hint hint,
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops)
+      : Resource(name, device, desc, hint, interops)
+    {
+    }
+  };
+
+  class TestBatch : public Batch
+  {
+  public:
+    void Initialize() override {}
+    void Use() override {}
+    void Discard() override {}
+
+  public:
+    using Batch::Batch;
+  };
+
+  class TestConfig : public Config
+  {
+  public:
+    const std::shared_ptr<Batch>& CreateBatch(const std::string& name,
+      const std::pair<const Batch::Entity*, uint32_t>& entities,
+      const std::pair<const Batch::Sampler*, uint32_t>& samplers,
+      const std::pair<const std::shared_ptr<View>*, uint32_t>& ub_views,
+      const std::pair<const std::shared_ptr<View>*, uint32_t>& sb_views,
+      const std::pair<const std::shared_ptr<View>*, uint32_t>& ri_views,
+      const std::pair<const std::shared_ptr<View>*, uint32_t>& wi_views,
+      const std::pair<const std::shared_ptr<View>*, uint32_t>& rb_views,
+      const std::pair<const std::shared_ptr<View>*, uint32_t>& wb_views
+    ) override
+    {
+      return batches.emplace_back(new TestBatch(name, *this, entities, samplers, ub_views, sb_views, ri_views, wi_views, rb_views, wb_views));
+    }
+
+  public:
+    void Initialize() override {}
+    void Use() override {}
+    void Discard() override {}
+
+  public:
+    TestConfig(const std::string& name, Pass& pass)
+      : Config(name, pass, std::string(), Config::COMPILATION_CS, {})
+    {
+    }
+  };
+
+  class TestPass : public Pass
+  {
+  public:
+    const std::shared_ptr<Config>& CreateConfig(const std::string& name,
+      const std::string& source,
+      Config::Compilation compilation,
+      const std::pair<const std::pair<std::string, std::string>*, uint32_t>& defines,
+      const Config::IAState& ia_state,
+      const Config::RCState& rc_state,
+      const Config::DSState& ds_state,
+      const Config::OMState& om_state) override
+    {
+      return configs.emplace_back(new TestConfig(name, *this));
+    }
+
+  public:
+    void Initialize() override {}
+    void Use() override {}
+    void Discard() override {}
+
+  public:
+    using Pass::Pass;
+  };
+
+  class TestDevice : public Device
+  {
+  public:
+    using Device::CreateResource;
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::BufferDesc& desc,
+      Resource::Hint hint,
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops) override
+    {
+      return resources.emplace_back(new TestResource(name, *this, desc, hint, interops));
+    }
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::Tex1DDesc& desc,
+      Resource::Hint hint,
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops) override
+    {
+      return resources.emplace_back(new TestResource(name, *this, desc, hint, interops));
+    }
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::Tex2DDesc& desc,
+      Resource::Hint hint,
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops) override
+    {
+      return resources.emplace_back(new TestResource(name, *this, desc, hint, interops));
+    }
+    const std::shared_ptr<Resource>& CreateResource(const std::string& name,
+      const Resource::Tex3DDesc& desc,
+      Resource::Hint hint,
+      const std::pair<std::pair<const void*, uint64_t>*, uint32_t>& interops) override
+    {
+      return resources.emplace_back(new TestResource(name, *this, desc, hint, interops));
+    }
+
+    const std::shared_ptr<Pass>& CreatePass(const std::string& name,
+      Pass::Type type,
+      uint32_t size_x,
+      uint32_t size_y,
+      uint32_t layers,
+      const std::pair<const Pass::RTAttachment*, uint32_t>& rt_attachments,
+      const std::pair<const Pass::DSAttachment*, uint32_t>& ds_attachments) override
+    {
+      return passes.emplace_back(new TestPass(name, *this, type, size_x, size_y, layers, rt_attachments, ds_attachments));
+    }
+
+  public:
+    void Initialize() override {}
+    void Use() override { Schedule(); }
+    void Discard() override {}
+
+  public:
+    TestDevice() : Device("test") {}
+  };
+
+  // One compute pass with a single batch reading and writing the given buffers
+  void AddPass(Device& device, const std::string& name,
+    const std::vector<std::shared_ptr<View>>& reads, const std::vector<std::shared_ptr<View>>& writes)
+  {
+    const auto& pass = device.CreatePass(name, Pass::TYPE_COMPUTE, 0, 0, 1, { nullptr, 0 }, { nullptr, 0 });
+    pass->SetEnabled(true);
+
+    const auto& config = pass->CreateConfig(name, std::string(), Config::COMPILATION_CS, { nullptr, 0 },
+      Config::IAState{}, Config::RCState{}, Config::DSState{}, Config::OMState{});
+    config->CreateBatch(name, { nullptr, 0 }, {}, {}, {}, {}, {},
+      { reads.data(), uint32_t(reads.size()) }, { writes.data(), uint32_t(writes.size()) });
+  }
+
+  bool Scheduled(const Device& device, const std::string& name)
+  {
+    auto found = false;
+    device.VisitSchedule([&found, &name](const std::shared_ptr<Pass>& pass)
+    {
+      found = pass->GetName() == name;
+      return found;
+    });
+    return found;
+  }
+}
+
+int main()
+{
+  TestDevice device;
+
+  Resource::BufferDesc desc;
+  desc.usage = USAGE_UNORDERED_ACCESS;
+  desc.stride = 16;
+  desc.count = 256;
+
+  const auto& target = device.CreateResource("screen", desc, Resource::HINT_UNKNOWN, {});
+  device.SetScreen(target);
+
+  const auto screen = target->CreateView("screen", USAGE_UNORDERED_ACCESS);
+  const auto source = device.CreateResource("source", desc, Resource::HINT_UNKNOWN, {})->CreateView("source", USAGE_UNORDERED_ACCESS);
+  const auto readback = device.CreateResource("readback", desc, Resource::HINT_READBACK_BUFFER, {})->CreateView("readback", USAGE_UNORDERED_ACCESS);
+  const auto unused = device.CreateResource("unused", desc, Resource::HINT_UNKNOWN, {})->CreateView("unused", USAGE_UNORDERED_ACCESS);
+
+  // The screen roots the graph, so only the readback hint keeps the copy chain alive
+  AddPass(device, "present", {}, { screen });
+  AddPass(device, "produce", {}, { source });
+  AddPass(device, "copy", { source }, { readback });
+  AddPass(device, "dead", {}, { unused });
+
+  device.Use();
+
+  if (!Scheduled(device, "present")) return 1;
+  if (!Scheduled(device, "produce")) return 2;
+  if (!Scheduled(device, "copy")) return 3;
+  if (Scheduled(device, "dead")) return 4;
+
+  return 0;
+}
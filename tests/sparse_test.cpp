@@ -0,0 +1,134 @@
+/*================================================================================
+RayGene3D Framework
+--------------------------------------------------------------------------------
+RayGene3D is licensed under MIT License
+================================================================================
+The MIT License
+--------------------------------------------------------------------------------
+Copyright (c) 2021
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+================================================================================*/
+
+
+#include "../core/vlk/vlk_device.h"
+#include "../core/vlk/vlk_resource.h"
+
+using namespace RayGene3D;
+
+// Sparse support is turned off on purpose, resources asking for it have to fall back to regular
+// memory while commits keep the same bookkeeping callers rely on
+int main()
+{
+  const auto display = XOpenDisplay(nullptr);
+  if (display == nullptr) return 77; // nothing to present to, skipped
+
+  const auto window = XCreateSimpleWindow(display, DefaultRootWindow(display), 0, 0, 64, 64, 0, 0, 0);
+
+  auto result = 0;
+  {
+    VLKDevice device("sparse");
+    device.SetSparse(false);
+    device.SetExtentX(64);
+    device.SetExtentY(64);
+    device.SetDisplay(display);
+    device.SetWindow(reinterpret_cast<void*>(window));
+    device.Initialize();
+
+    const auto page_size = device.GetPageSize();
+
+    Resource::BufferDesc buffer_desc;
+    buffer_desc.usage = USAGE_SHADER_RESOURCE;
+    buffer_desc.stride = 16;
+    buffer_desc.count = uint32_t(4 * page_size / 16);
+    const auto buffer = reinterpret_cast<VLKResource*>(device.CreateResource("buffer", buffer_desc, Resource::HINT_SPARSE_RESOURCE).get());
+
+    Resource::Tex2DDesc image_desc;
+    image_desc.usage = USAGE_SHADER_RESOURCE;
+    image_desc.mipmaps = 1;
+    image_desc.layers = 1;
+    image_desc.format = FORMAT_R8G8B8A8_UNORM;
+    image_desc.size_x = 512;
+    image_desc.size_y = 512;
+    const auto image = reinterpret_cast<VLKResource*>(device.CreateResource("image", image_desc, Resource::HINT_SPARSE_RESOURCE).get());
+
+    Resource::Tex3DDesc volume_desc;
+    volume_desc.usage = USAGE_SHADER_RESOURCE;
+    volume_desc.mipmaps = 1;
+    volume_desc.layers = 1;
+    volume_desc.format = FORMAT_R8G8B8A8_UNORM;
+    volume_desc.size_x = 64;
+    volume_desc.size_y = 64;
+    volume_desc.size_z = 64;
+    const auto volume = reinterpret_cast<VLKResource*>(device.CreateResource("volume", volume_desc, Resource::HINT_SPARSE_RESOURCE).get());
+
+    if (device.GetSparseSupported() || device.GetSparse3DSupported()) result = 1;
+    else if (buffer->GetSparse() || !buffer->GetBuffer() || !buffer->GetMemory()) result = 2;
+    else if (image->GetSparse() || !image->GetImage() || !image->GetMemory()) result = 3;
+    else if (volume->GetSparse() || !volume->GetImage() || !volume->GetMemory()) result = 8;
+
+    if (result == 0)
+    {
+      buffer->CommitPages(0, 2 * page_size, true);
+      if (!buffer->IsCommitted(0) || !buffer->IsCommitted(page_size) || buffer->IsCommitted(2 * page_size)) result = 4;
+
+      buffer->CommitPages(0, page_size, false);
+      if (buffer->IsCommitted(0) || !buffer->IsCommitted(page_size)) result = 5;
+    }
+
+    if (result == 0)
+    {
+      image->CommitTiles(0, 0, { 0, 0, 0 }, { 128, 128, 1 }, true);
+      if (!image->IsCommitted(0, 0, { 0, 0, 0 }) || image->IsCommitted(0, 0, { 256, 0, 0 })) result = 6;
+
+      image->CommitTiles(0, 0, { 0, 0, 0 }, { 128, 128, 1 }, false);
+      if (image->IsCommitted(0, 0, { 0, 0, 0 })) result = 7;
+    }
+  }
+
+  // With sparse left on, volumes are only sparse where the device has residency for them
+  if (result == 0)
+  {
+    VLKDevice device("sparse_3d");
+    device.SetExtentX(64);
+    device.SetExtentY(64);
+    device.SetDisplay(display);
+    device.SetWindow(reinterpret_cast<void*>(window));
+    device.Initialize();
+
+    Resource::Tex3DDesc volume_desc;
+    volume_desc.usage = USAGE_SHADER_RESOURCE;
+    volume_desc.mipmaps = 1;
+    volume_desc.layers = 1;
+    volume_desc.format = FORMAT_R8G8B8A8_UNORM;
+    volume_desc.size_x = 64;
+    volume_desc.size_y = 64;
+    volume_desc.size_z = 64;
+    const auto volume = reinterpret_cast<VLKResource*>(device.CreateResource("volume", volume_desc, Resource::HINT_SPARSE_RESOURCE).get());
+
+    if (device.GetSparse3DSupported() && !device.GetSparseSupported()) result = 9;
+    else if (volume->GetSparse() && !device.GetSparse3DSupported()) result = 10;
+    else if (!volume->GetSparse() && (!volume->GetImage() || !volume->GetMemory())) result = 11;
+  }
+
+  XDestroyWindow(display, window);
+  XCloseDisplay(display);
+
+  return result;
+}